@@ -52,7 +52,23 @@ docker run --rm \
 		--models pinhole-radtan pinhole-radtan \
 		--topics /cam0/image_raw /cam1/image_raw \
 		--approx-sync 0.02 \
-		--dont-show-report || exit 1
+		--dont-show-report
+	STATUS=\$?
+
+	# resource usage of the container cgroup (= Kalibr), sert adds it to its trace
+	CG=/sys/fs/cgroup
+	{
+		if [ -f \$CG/cpu.stat ]; then
+			echo \"cpu_user_ms \$((\$(grep '^user_usec' \$CG/cpu.stat | cut -d' ' -f2) / 1000))\"
+			echo \"cpu_sys_ms \$((\$(grep '^system_usec' \$CG/cpu.stat | cut -d' ' -f2) / 1000))\"
+			[ -f \$CG/memory.peak ] && echo \"peak_memory_mb \$((\$(cat \$CG/memory.peak) / 1048576))\"
+		elif [ -f \$CG/cpuacct/cpuacct.usage ]; then
+			echo \"cpu_ms \$((\$(cat \$CG/cpuacct/cpuacct.usage) / 1000000))\"
+			echo \"peak_memory_mb \$((\$(cat \$CG/memory/memory.max_usage_in_bytes) / 1048576))\"
+		fi
+	} > /data/calibration/kalibr_resource_usage.txt 2>/dev/null
+
+	[ \$STATUS -eq 0 ] || exit 1
 	
 	echo 'Moving results...';
     mv /data/intermediate/stereo_frames-camchain.yaml /data/calibration/ 2>/dev/null || true;
@@ -1,6 +1,7 @@
 #include "Calibrator.h"
 #include "FrameGenerator.h"
 #include "Log.h"
+#include "Tracer.h"
 
 namespace Calib
 {
@@ -18,13 +19,14 @@ namespace Calib
 
 		Log::info("Executin: ", command);
 
-		int result = std::system(command.c_str());
+		int result = Trace::runCommand("stereo_frames_to_rosbag", command);
 		return (result == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 	}
 	int run(const std::filesystem::path sessionPath)
 	{
 		std::string command = std::string(SCRIPTS_DIR) + "run_kalibr.sh \"" + sessionPath.string() + "\"";
-		int result = std::system(command.c_str());	
+		// Kalibr runs in a docker container, its own CPU time and memory come from the container's cgroup
+		int result = Trace::runCommand("kalibr", command, sessionPath / "calibration" / "kalibr_resource_usage.txt");
 		int exit_code = 0;
 		if (WIFEXITED(result)) 
 		{
@@ -0,0 +1,251 @@
+#include "E2VIDOnnx.h"
+#include "EventPipeline.h"
+#include "FrameGenerator.h"
+#include "Log.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace FrameGen
+{
+	// same settings as the conda path (--fixed_duration --window_duration 50)
+	static constexpr int64_t WINDOW_DURATION_US = 50000;
+
+	// the export pads to a multiple of 2^num_encoders (8 for E2VID), i.e. by at most 7 pixels. A model that is
+	// 8 or more pixels larger than the input was exported for another resolution and would spend most of its time
+	// on the zero padding
+	static constexpr int MAX_MODEL_PADDING = 8;
+
+	// rpg_e2vid's default post-processing (--unsharp_mask_amount 0.3 --unsharp_mask_sigma 1.0, 5x5 kernel),
+	// the python backend runs with it and Kalibr sees those frames
+	static constexpr double UNSHARP_MASK_AMOUNT = 0.3;
+	static constexpr double UNSHARP_MASK_SIGMA = 1.0;
+	static constexpr int UNSHARP_MASK_KERNEL_SIZE = 5;
+
+	// ONNX Runtime wants a single environment per process, sessions may share it across threads
+	static Ort::Env& ortEnv()
+	{
+		static Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "sert");
+		return env;
+	}
+
+	struct E2VIDOnnx::Impl
+	{
+		Ort::Session session{nullptr};
+		Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+
+		std::vector<std::string> inputNames, outputNames;
+		std::vector<const char*> inputNamePtrs, outputNamePtrs;
+		std::vector<std::vector<int64_t>> inputShapes;
+
+		// recurrent states, owned by ONNX Runtime after the first window
+		std::vector<Ort::Value> states;
+		std::vector<std::vector<float>> zeroStates;
+
+		std::vector<float> voxelGrid;
+		cv::Mat blurred, sharpened;
+		cv::Size sensorResolution;
+		int numBins = 0, modelHeight = 0, modelWidth = 0;
+		int padTop = 0, padLeft = 0;
+	};
+
+	E2VIDOnnx::E2VIDOnnx(const std::filesystem::path& modelPath, const cv::Size& sensorResolution, int numThreads) : mImpl(std::make_unique<Impl>())
+	{
+		Ort::SessionOptions options;
+		options.SetIntraOpNumThreads(numThreads);
+		options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+		mImpl->session = Ort::Session(ortEnv(), modelPath.c_str(), options);
+
+		const size_t numInputs = mImpl->session.GetInputCount();
+		const size_t numOutputs = mImpl->session.GetOutputCount();
+		if (numInputs < 1 || numInputs != numOutputs)
+			throw std::runtime_error("E2VID model must have matching inputs/outputs (voxel grid + recurrent states)");
+
+		Ort::AllocatorWithDefaultOptions allocator;
+		for (size_t i = 0; i < numInputs; i++)
+		{
+			mImpl->inputNames.emplace_back(mImpl->session.GetInputNameAllocated(i, allocator).get());
+			mImpl->outputNames.emplace_back(mImpl->session.GetOutputNameAllocated(i, allocator).get());
+
+			auto shape = mImpl->session.GetInputTypeInfo(i).GetTensorTypeAndShapeInfo().GetShape();
+			for (int64_t dim : shape)
+			{
+				if (dim <= 0)
+					throw std::runtime_error("E2VID model input '" + mImpl->inputNames.back() + "' has a dynamic shape, re-export it for a fixed resolution");
+			}
+			mImpl->inputShapes.push_back(std::move(shape));
+		}
+		for (size_t i = 0; i < numInputs; i++)
+		{
+			mImpl->inputNamePtrs.push_back(mImpl->inputNames[i].c_str());
+			mImpl->outputNamePtrs.push_back(mImpl->outputNames[i].c_str());
+		}
+
+		// voxel grid is NCHW = [1, bins, height, width]
+		const auto& voxelShape = mImpl->inputShapes[0];
+		if (voxelShape.size() != 4)
+			throw std::runtime_error("E2VID model voxel grid input must be 4D (1 x bins x height x width)");
+
+		mImpl->numBins = static_cast<int>(voxelShape[1]);
+		mImpl->modelHeight = static_cast<int>(voxelShape[2]);
+		mImpl->modelWidth = static_cast<int>(voxelShape[3]);
+		mImpl->sensorResolution = sensorResolution;
+
+		if (mImpl->modelWidth < sensorResolution.width || mImpl->modelHeight < sensorResolution.height)
+			throw std::runtime_error("E2VID model resolution is smaller than the sensor resolution");
+		if (mImpl->modelWidth - sensorResolution.width >= MAX_MODEL_PADDING || mImpl->modelHeight - sensorResolution.height >= MAX_MODEL_PADDING)
+		{
+			const std::string size = std::to_string(sensorResolution.width) + "x" + std::to_string(sensorResolution.height);
+			throw std::runtime_error("E2VID model is " + std::to_string(mImpl->modelWidth) + "x" + std::to_string(mImpl->modelHeight) + " but the events are "
+				+ size + ", export a model for " + size + " (export_e2vid_onnx.py --width " + std::to_string(sensorResolution.width)
+				+ " --height " + std::to_string(sensorResolution.height) + ") and pass it with -m");
+		}
+
+		// rpg_e2vid zero pads the input centered to a multiple of 2^num_encoders, the export keeps that padded size.
+		// CropParameters rounds the top/left padding up (ceil), an odd difference puts the extra row/column on top/left
+		mImpl->padTop = (mImpl->modelHeight - sensorResolution.height + 1) / 2;
+		mImpl->padLeft = (mImpl->modelWidth - sensorResolution.width + 1) / 2;
+		mImpl->voxelGrid.resize(static_cast<size_t>(mImpl->numBins) * mImpl->modelHeight * mImpl->modelWidth);
+
+		resetStates();
+	}
+
+	E2VIDOnnx::~E2VIDOnnx() = default;
+
+	void E2VIDOnnx::resetStates()
+	{
+		mImpl->states.clear();
+		mImpl->zeroStates.clear();
+		for (size_t i = 1; i < mImpl->inputShapes.size(); i++)
+		{
+			const auto& shape = mImpl->inputShapes[i];
+			size_t count = 1;
+			for (int64_t dim : shape)
+				count *= static_cast<size_t>(dim);
+
+			auto& storage = mImpl->zeroStates.emplace_back(count, 0.0f);
+			mImpl->states.push_back(Ort::Value::CreateTensor<float>(mImpl->memoryInfo, storage.data(), storage.size(), shape.data(), shape.size()));
+		}
+	}
+
+	cv::Mat E2VIDOnnx::reconstruct(const dv::EventStore& window)
+	{
+		Impl& impl = *mImpl;
+		std::fill(impl.voxelGrid.begin(), impl.voxelGrid.end(), 0.0f);
+
+		// bilinear voxel grid in time, identical to rpg_e2vid's events_to_voxel_grid
+		if (!window.isEmpty())
+		{
+			const int64_t firstStamp = window.getLowestTime();
+			double deltaT = static_cast<double>(window.getHighestTime() - firstStamp);
+			if (deltaT == 0.0)
+				deltaT = 1.0;
+
+			const double scale = (impl.numBins - 1) / deltaT;
+			const size_t planeSize = static_cast<size_t>(impl.modelHeight) * impl.modelWidth;
+
+			for (const dv::Event& ev : window)
+			{
+				const double ts = scale * static_cast<double>(ev.timestamp() - firstStamp);
+				const int ti = static_cast<int>(ts);
+				const float dts = static_cast<float>(ts - ti);
+				const float pol = ev.polarity() ? 1.0f : -1.0f;
+				const size_t pixel = static_cast<size_t>(ev.y() + impl.padTop) * impl.modelWidth + (ev.x() + impl.padLeft);
+
+				if (ti < impl.numBins)
+					impl.voxelGrid[ti * planeSize + pixel] += pol * (1.0f - dts);
+				if (ti + 1 < impl.numBins)
+					impl.voxelGrid[(ti + 1) * planeSize + pixel] += pol * dts;
+			}
+		}
+
+		std::vector<Ort::Value> inputs;
+		inputs.reserve(impl.inputShapes.size());
+		const auto& voxelShape = impl.inputShapes[0];
+		inputs.push_back(Ort::Value::CreateTensor<float>(impl.memoryInfo, impl.voxelGrid.data(), impl.voxelGrid.size(), voxelShape.data(), voxelShape.size()));
+		for (auto& state : impl.states)
+			inputs.push_back(std::move(state));
+
+		auto outputs = impl.session.Run(Ort::RunOptions{nullptr}, impl.inputNamePtrs.data(), inputs.data(), inputs.size(), impl.outputNamePtrs.data(), impl.outputNamePtrs.size());
+
+		// hand the new recurrent states back in for the next window without copying
+		impl.states.clear();
+		for (size_t i = 1; i < outputs.size(); i++)
+			impl.states.push_back(std::move(outputs[i]));
+		impl.zeroStates.clear();
+
+		// unsharp mask on the padded output like rpg_e2vid (conv2d with zero padding): (1 + a) * img - a * blur(img)
+		float* image = outputs[0].GetTensorMutableData<float>();
+		cv::Mat padded(impl.modelHeight, impl.modelWidth, CV_32FC1, image);
+		cv::GaussianBlur(padded, impl.blurred, cv::Size(UNSHARP_MASK_KERNEL_SIZE, UNSHARP_MASK_KERNEL_SIZE), UNSHARP_MASK_SIGMA, UNSHARP_MASK_SIGMA, cv::BORDER_CONSTANT);
+		cv::addWeighted(padded, 1.0 + UNSHARP_MASK_AMOUNT, impl.blurred, -UNSHARP_MASK_AMOUNT, 0.0, impl.sharpened);
+
+		// crop the padding away and scale [0,1] -> [0,255] (Imin 0, Imax 1), convertTo clamps like the intensity rescaler
+		cv::Mat frame;
+		impl.sharpened(cv::Rect(impl.padLeft, impl.padTop, impl.sensorResolution.width, impl.sensorResolution.height)).convertTo(frame, CV_8UC1, 255.0);
+		return frame;
+	}
+
+	int runE2VIDOnnx(const std::vector<std::filesystem::path>& recordingFiles, const std::string& camName, const std::filesystem::path& modelPath, const std::filesystem::path& outputDir, const std::string& datasetName, int numThreads, const Rectify::RectificationMap* rectification)
+	{
+		try
+		{
+			ChunkedEventReader reader(recordingFiles, camName);
+			if (!reader.isEventStreamAvailable() || !reader.getEventResolution().has_value())
+			{
+				Log::error("No event stream for camera ", camName, " in the recording");
+				return EXIT_FAILURE;
+			}
+			if (rectification && !rectification->checkResolution(reader.getEventResolution(), camName))
+				return EXIT_FAILURE;
+
+			E2VIDOnnx e2vid(modelPath, reader.getEventResolution().value(), numThreads);
+
+			std::filesystem::path framesDir = outputDir / datasetName;
+			std::filesystem::create_directories(framesDir);
+			std::ofstream timestampsFile(framesDir / "timestamps.txt");
+
+			size_t eventIndex = 0;
+			size_t frameCount = 0;
+			auto writeFrame = [&](const dv::EventStore& window)
+			{
+				eventIndex += window.size();
+				cv::Mat frame = e2vid.reconstruct(window);
+
+				// frame naming follows rpg_e2vid: index of the last event in the window
+				char fileName[32];
+				std::snprintf(fileName, sizeof(fileName), "frame_%010zu.png", eventIndex);
+				cv::imwrite((framesDir / fileName).string(), frame);
+
+				timestampsFile << std::fixed << std::setprecision(6) << (window.getHighestTime() / 1e6) << "\n";
+				frameCount++;
+			};
+
+			Log::info("[", datasetName, "] Running E2VID (ONNX Runtime, ", numThreads, " threads)...");
+			Trace::Span span("E2VID onnx (" + datasetName + ")");
+
+			WindowSink windows(WINDOW_DURATION_US, writeFrame);
+			runPipeline(reader, RectifyTransform{rectification}, windows);
+
+			span.arg("frames", frameCount);
+			span.arg("events", eventIndex);
+			Log::info("[", datasetName, "] Finished, wrote ", frameCount, " frames");
+			return EXIT_SUCCESS;
+		}
+		catch (const std::exception& e)
+		{
+			Log::error("[", datasetName, "] E2VID (ONNX Runtime) failed: ", e.what());
+			return EXIT_FAILURE;
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <dv-processing/core/core.hpp>
+#include <opencv2/core.hpp>
+
+#include "Rectifier.h"
+
+namespace FrameGen
+{
+	// In-process E2VID inference on the CPU through ONNX Runtime.
+	// The model is an ONNX export of E2VID_lightweight (src/python/export_e2vid_onnx.py)
+	// whose first input/output are the voxel grid/image and whose remaining
+	// inputs/outputs are the recurrent states, in matching order.
+	// One instance holds the recurrent state of exactly one camera.
+	class E2VIDOnnx
+	{
+		public:
+			E2VIDOnnx(const std::filesystem::path& modelPath, const cv::Size& sensorResolution, int numThreads);
+			~E2VIDOnnx();
+
+			// Reconstructs one event window into an 8-bit grayscale image of sensor resolution
+			cv::Mat reconstruct(const dv::EventStore& window);
+			void resetStates();
+
+		private:
+			struct Impl;
+			std::unique_ptr<Impl> mImpl;
+	};
+
+	// Reconstructs all events of one camera (across all chunks) in fixed 50ms windows and writes
+	// <outputDir>/<datasetName>/frame_XXXXXXXXXX.png and timestamps.txt (same layout as rpg_e2vid).
+	// If a rectification map is given, events are rectified before reconstruction.
+	int runE2VIDOnnx(const std::vector<std::filesystem::path>& recordingFiles, const std::string& camName, const std::filesystem::path& modelPath, const std::filesystem::path& outputDir, const std::string& datasetName, int numThreads, const Rectify::RectificationMap* rectification = nullptr);
+}
@@ -0,0 +1,202 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <optional>
+#include <utility>
+
+#include <dv-processing/core/core.hpp>
+#include <opencv2/core.hpp>
+
+#include "Rectifier.h"
+
+// Event processing composed at compile time: source -> transform -> sinks...
+//
+//   Source:    std::optional<dv::EventStore> getNextEventBatch()   (ChunkedEventReader, MonoCameraRecording, ...)
+//   Transform: dv::EventStore operator()(const dv::EventStore&) const
+//   Sink:      void accept(const dv::EventStore&), void finish()
+//
+// runPipeline decodes every batch once and hands it to all sinks in order. All types are template parameters,
+// so the per-event loops of the sinks inline into the pipeline without virtual calls.
+namespace FrameGen
+{
+	struct IdentityTransform
+	{
+		const dv::EventStore& operator()(const dv::EventStore& events) const { return events; }
+	};
+
+	// rectifies/undistorts with a lookup table, passes events through if there is none
+	struct RectifyTransform
+	{
+		const Rectify::RectificationMap* map = nullptr;
+
+		dv::EventStore operator()(const dv::EventStore& events) const { return map ? map->apply(events) : events; }
+	};
+
+	// bins events into scale x scale pixel blocks (coordinates divided by scale)
+	struct DownscaleTransform
+	{
+		int scale = 1;
+
+		dv::EventStore operator()(const dv::EventStore& events) const
+		{
+			if (scale <= 1)
+				return events;
+			dv::EventStore scaled;
+			for (const dv::Event& ev : events)
+				scaled.emplace_back(ev.timestamp(), static_cast<int16_t>(ev.x() / scale), static_cast<int16_t>(ev.y() / scale), ev.polarity());
+			return scaled;
+		}
+	};
+
+	// first, then second
+	template<typename First, typename Second>
+	struct ChainedTransform
+	{
+		First first;
+		Second second;
+
+		dv::EventStore operator()(const dv::EventStore& events) const { return second(first(events)); }
+	};
+
+	template<typename First, typename Second>
+	ChainedTransform<First, Second> chain(First first, Second second)
+	{
+		return {std::move(first), std::move(second)};
+	}
+
+	// applies a transform in front of a single sink, e.g. to write raw and rectified events in the same pass
+	template<typename Transform, typename Sink>
+	class TransformedSink
+	{
+		public:
+			TransformedSink(Transform transform, Sink& sink) : mTransform(std::move(transform)), mSink(sink) {}
+
+			void accept(const dv::EventStore& events) { mSink.accept(mTransform(events)); }
+			void finish() { mSink.finish(); }
+
+		private:
+			Transform mTransform;
+			Sink& mSink;
+	};
+
+	// Reads the source to the end and fans every (transformed) batch out to all sinks, returns the number of batches
+	template<typename Source, typename Transform, typename... Sinks>
+	size_t runPipeline(Source& source, const Transform& transform, Sinks&... sinks)
+	{
+		static_assert(sizeof...(Sinks) > 0, "a pipeline needs at least one sink");
+		size_t batches = 0;
+		while (true)
+		{
+			std::optional<dv::EventStore> events = source.getNextEventBatch();
+			if (!events.has_value())
+				break;
+			const auto& transformed = transform(*events);
+			(sinks.accept(transformed), ...);
+			batches++;
+		}
+		(sinks.finish(), ...);
+		return batches;
+	}
+
+	// E2VID text input: "<width> <height>" header, then one "t[s] x y p" line per event.
+	// With append, events are added to the end of an existing file (which already has the header).
+	class TxtEventSink
+	{
+		public:
+			TxtEventSink(const std::filesystem::path& file, const cv::Size& resolution, bool append = false) : mFile(file, append ? std::ios::app : std::ios::out)
+			{
+				if (!append)
+					mFile << resolution.width << " " << resolution.height << "\n";
+				// E2VID expects timestamps in seconds (float), not microseconds
+				mFile << std::fixed << std::setprecision(6);
+			}
+
+			void accept(const dv::EventStore& events)
+			{
+				for (const dv::Event& ev : events)
+					mFile << (ev.timestamp() / 1e6) << " " << ev.x() << " " << ev.y() << " " << ev.polarity() << "\n";
+				mCount += events.size();
+			}
+
+			void finish() { mFile.close(); }
+
+			size_t count() const { return mCount; }
+
+		private:
+			std::ofstream mFile;
+			size_t mCount = 0;
+	};
+
+	// Cuts the stream into fixed windows of windowUs, counted from the first event, and calls callback(window)
+	// for every `every`th window that has events, the last (partial) one on finish. Only the events of those
+	// windows are kept (sliceTime does not copy), so per-event work on skipped windows is left to the callback.
+	template<typename Callback>
+	class WindowSink
+	{
+		public:
+			WindowSink(int64_t windowUs, Callback callback, int64_t every = 1) : mWindowUs(windowUs), mEvery(every), mCallback(std::move(callback)) {}
+
+			void accept(const dv::EventStore& events)
+			{
+				if (events.isEmpty())
+					return;
+				if (mOrigin < 0)
+					mOrigin = events.getLowestTime();
+
+				while (true)
+				{
+					const int64_t windowStart = mOrigin + mWindow * mWindowUs;
+					const int64_t windowEnd = windowStart + mWindowUs;
+
+					// skip the windows of a gap in one step
+					const int64_t skip = (events.getLowestTime() - windowStart) / mWindowUs / mEvery * mEvery;
+					if (mPending.isEmpty() && skip > 0)
+					{
+						mWindow += skip;
+						continue;
+					}
+
+					if (events.getHighestTime() < windowStart)
+						break;
+					mPending.add(events.sliceTime(windowStart, windowEnd));
+					if (events.getHighestTime() < windowEnd)
+						break;
+					emit();
+					mWindow += mEvery;
+				}
+			}
+
+			void finish() { emit(); }
+
+		private:
+			void emit()
+			{
+				if (mPending.isEmpty())
+					return;
+				mCallback(mPending);
+				mPending = dv::EventStore();
+			}
+
+			int64_t mWindowUs;
+			int64_t mEvery;
+			Callback mCallback;
+			int64_t mOrigin = -1;
+			int64_t mWindow = 0; // index of the window that is collected next
+			dv::EventStore mPending;
+	};
+
+	// only counts, e.g. to report how many events a transform dropped
+	class CountingSink
+	{
+		public:
+			void accept(const dv::EventStore& events) { mCount += events.size(); }
+			void finish() {}
+
+			size_t count() const { return mCount; }
+
+		private:
+			size_t mCount = 0;
+	};
+}
@@ -1,13 +1,24 @@
+#include <algorithm>
+#include <cstdio>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
+#include <sstream>
+#include <memory>
+#include <thread>
 
 #include <dv-processing/core/core.hpp>
-#include <dv-processing/io/stereo_camera_recording.hpp>
+#include <dv-processing/core/frame.hpp>
+#include <opencv2/imgcodecs.hpp>
 
+#include "EventPipeline.h"
 #include "FrameGenerator.h"
 #include "Log.h"
+#include "Tracer.h"
+#ifdef SERT_WITH_ONNXRUNTIME
+#include "E2VIDOnnx.h"
+#endif
 
 namespace FrameGen
 {
@@ -35,11 +46,82 @@ namespace FrameGen
 		return meta;	
 	}
 	
+	std::vector<std::filesystem::path> recordingFiles(const std::filesystem::path& rawDir)
+	{
+		std::vector<std::filesystem::path> files;
+		std::ifstream manifest(rawDir / CHUNK_MANIFEST);
+		if (manifest.is_open())
+		{
+			std::string line;
+			// Skip the first "Do not change" line
+			std::getline(manifest, line);
+			while (std::getline(manifest, line))
+			{
+				std::istringstream entry(line);
+				std::string fileName;
+				if (entry >> fileName)
+					files.push_back(rawDir / fileName);
+			}
+			return files;
+		}
+
+		if (std::filesystem::exists(rawDir / "stereo_recording.aedat4"))
+			files.push_back(rawDir / "stereo_recording.aedat4");
+		return files;
+	}
+
+	ChunkedEventReader::ChunkedEventReader(std::vector<std::filesystem::path> files, const std::string& camName) : mFiles(std::move(files)), mCamName(camName)
+	{
+		if (!mFiles.empty())
+			mReader = std::make_unique<dv::io::MonoCameraRecording>(mFiles.front(), mCamName);
+	}
+
+	bool ChunkedEventReader::isEventStreamAvailable() const
+	{
+		return mReader && mReader->isEventStreamAvailable();
+	}
+
+	std::optional<cv::Size> ChunkedEventReader::getEventResolution() const
+	{
+		if (!mReader)
+			return std::nullopt;
+		return mReader->getEventResolution();
+	}
+
+	std::pair<int64_t, int64_t> ChunkedEventReader::getTimeRange() const
+	{
+		if (mFiles.empty())
+			return {0, 0};
+
+		// chunks are in time order, only the outer ones matter
+		const auto first = dv::io::MonoCameraRecording(mFiles.front(), mCamName).getTimeRange();
+		if (mFiles.size() == 1)
+			return first;
+		const auto last = dv::io::MonoCameraRecording(mFiles.back(), mCamName).getTimeRange();
+		return {first.first, last.second};
+	}
+
+	std::optional<dv::EventStore> ChunkedEventReader::getNextEventBatch()
+	{
+		while (mReader)
+		{
+			auto events = mReader->getNextEventBatch();
+			if (events.has_value())
+				return events;
+
+			// continue with the next chunk
+			mReader.reset();
+			if (++mCurrentFile < mFiles.size())
+				mReader = std::make_unique<dv::io::MonoCameraRecording>(mFiles[mCurrentFile], mCamName);
+		}
+		return std::nullopt;
+	}
+
 	int environment_installed()
 	{
 		// TODO: change the way the path is handled here (maybe using make install
 		// later)
-		int result = std::system(SCRIPTS_DIR "check_env.sh");	
+		int result = Trace::runCommand("check_env", SCRIPTS_DIR "check_env.sh");	
 		int exit_code = 0;
 		if (WIFEXITED(result)) 
 		{
@@ -62,66 +144,93 @@ namespace FrameGen
 		return EXIT_FAILURE;
 	}
 
-	int convertAedat4ToTxt(const std::filesystem::path& inputAedat4, const std::filesystem::path& outputDir, const std::string& leftCamName, const std::string& rightCamName) 
+	// <file>.chunks lists the recording files an intermediate .txt was exported from, in order.
+	// It is removed before and written after an export, so a missing list means the .txt cannot be trusted.
+	static std::filesystem::path coveragePath(const std::filesystem::path& txtPath)
+	{
+		return txtPath.string() + ".chunks";
+	}
+
+	static std::vector<std::string> readCoverage(const std::filesystem::path& txtPath)
+	{
+		std::vector<std::string> covered;
+		if (!std::filesystem::exists(txtPath))
+			return covered;
+		std::ifstream file(coveragePath(txtPath));
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (!line.empty())
+				covered.push_back(line);
+		}
+		return covered;
+	}
+
+	static void writeCoverage(const std::filesystem::path& txtPath, const std::vector<std::filesystem::path>& files)
+	{
+		std::ofstream file(coveragePath(txtPath));
+		for (const auto& recordingFile : files)
+			file << recordingFile.filename().string() << "\n";
+	}
+
+	// Brings the E2VID .txt of one camera up to date with the recording files: nothing to do if it covers all of them,
+	// only the new chunks are appended if it covers a prefix (render during a chunked capture), otherwise a full export.
+	// One pass over the events: E2VID .txt (rectified if a map is given) plus the raw event count
+	static void exportCameraTxt(const std::vector<std::filesystem::path>& recordingFiles, const std::string& camName, const std::filesystem::path& outPath, const std::string& side, const Rectify::RectificationMap* rectification)
+	{
+		std::vector<std::string> fileNames;
+		for (const auto& recordingFile : recordingFiles)
+			fileNames.push_back(recordingFile.filename().string());
+
+		const std::vector<std::string> covered = readCoverage(outPath);
+		if (covered == fileNames)
+		{
+			Log::info(outPath.filename().string(), " is up to date (", covered.size(), " recording file(s))");
+			return;
+		}
+		const bool append = !covered.empty() && covered.size() < fileNames.size() && std::equal(covered.begin(), covered.end(), fileNames.begin());
+		const std::vector<std::filesystem::path> pending(recordingFiles.begin() + (append ? static_cast<std::ptrdiff_t>(covered.size()) : 0), recordingFiles.end());
+
+		Trace::Span span("aedat4 to txt (" + side + ")");
+		if (append)
+			Log::info("Appending ", pending.size(), " new chunk(s) to ", outPath.filename().string(), "...");
+		else
+			Log::info("Processing ", side, " events...");
+
+		std::filesystem::remove(coveragePath(outPath));
+		ChunkedEventReader reader(pending, camName);
+		TxtEventSink txt(outPath, cv::Size(640, 480), append);
+		TransformedSink<RectifyTransform, TxtEventSink> rectifiedTxt(RectifyTransform{rectification}, txt);
+		CountingSink raw;
+		runPipeline(reader, IdentityTransform{}, rectifiedTxt, raw);
+		writeCoverage(outPath, recordingFiles);
+
+		span.arg("events", txt.count());
+		span.arg("files", pending.size());
+		Log::info("Finished processing!\n", side, " file got ", txt.count(), " lines");
+		if (rectification)
+			Log::info(raw.count() - txt.count(), " of ", raw.count(), " ", side, " events fell outside the rectified image");
+	}
+
+	int convertAedat4ToTxt(const std::vector<std::filesystem::path>& inputAedat4, const std::filesystem::path& outputDir, const std::string& leftCamName, const std::string& rightCamName, const Rectify::StereoRectification* rectification) 
 	{
 		
-		dv::io::StereoCameraRecording recording = dv::io::StereoCameraRecording(inputAedat4, leftCamName, rightCamName);
+		ChunkedEventReader leftReader(inputAedat4, leftCamName);
+		ChunkedEventReader rightReader(inputAedat4, rightCamName);
+		const std::string suffix = rectification ? "EventsRectified.txt" : "Events.txt";
 		
-		if (recording.getLeftReader().isEventStreamAvailable() && recording.getRightReader().isEventStreamAvailable())
-		{
-			size_t leftLineCount = 0;
-			size_t rightLineCount = 0;
+		if (rectification && (!rectification->left.checkResolution(leftReader.getEventResolution(), leftCamName) || !rectification->right.checkResolution(rightReader.getEventResolution(), rightCamName)))
+			return EXIT_FAILURE;
 
-			std::filesystem::path leftOutPath = outputDir / "leftEvents.txt";
-			if (!std::filesystem::exists(leftOutPath))
-			{
-				std::ofstream leftOutFile(leftOutPath);
-				leftOutFile << 640 << " " << 480 << "\n";
-				// TODO: which recording?!
-				Log::info("Converting .aedat4 recording to .txt in preperation for E2VID:");
-				Log::info("Processing left events...");
-				while (true) {
-					auto leftEvents = recording.getLeftReader().getNextEventBatch();
-					// dv::EventStore sliced;
-					// for (size_t i = 0; i < (leftEvents->size()-1); i++)
-					// {
-					// 	sliced = leftEvents->slice(i, i+1);
-					// }
-					if(!leftEvents.has_value())
-						break;
-					for (const dv::Event &ev : *leftEvents)
-					{
-
-						// E2VID expects timestamps in seconds (float), not microseconds
-						leftOutFile << std::fixed << std::setprecision(6) << (ev.timestamp() / 1e6) << " " << ev.x() << " " << ev.y() << " " << ev.polarity() << "\n";		
-						leftLineCount++;
-					}
-				}
-				leftOutFile.close();
-				Log::info("Finished processing!\n","Left file has ", leftLineCount, " lines");
-			}
-			std::filesystem::path rightOutPath = outputDir / "rightEvents.txt";
-			if (!std::filesystem::exists(rightOutPath))
-			{
-				std::ofstream rightOutFile(rightOutPath);
-				rightOutFile << 640 << " " << 480 << "\n";
-				Log::info("Processing right events...");
-				while (true) {
-					auto rightEvents = recording.getRightReader().getNextEventBatch();
-					if(!rightEvents.has_value())
-						break;
-					for (const dv::Event &ev : *rightEvents)
-					{
-						// rightOutFile<< ev.timestamp() << " " << ev.x() << " " << ev.y() << " " << ev.polarity() << "\n";		
-						// E2VID expects timestamps in seconds (float), not microseconds
-						rightOutFile << std::fixed << std::setprecision(6) << (ev.timestamp() / 1e6) << " " << ev.x() << " " << ev.y() << " " << ev.polarity() << "\n";		
-						rightLineCount++;
-					}
-				}
-				rightOutFile.close();
-				Log::info("Finished processing!\n","Right file has ", rightLineCount, " lines");
-				Log::warn("The files ", leftOutPath, ", and ", rightOutPath, " were created. However they are quiet large. Consider removing them when E2VID finished the frame generation");			
-			}
+		if (leftReader.isEventStreamAvailable() && rightReader.isEventStreamAvailable())
+		{
+			std::filesystem::path leftOutPath = outputDir / ("left" + suffix);
+			std::filesystem::path rightOutPath = outputDir / ("right" + suffix);
+			// TODO: which recording?!
+			Log::info("Converting .aedat4 recording to .txt in preperation for E2VID:");
+			exportCameraTxt(inputAedat4, leftCamName, leftOutPath, "left", rectification ? &rectification->left : nullptr);
+			exportCameraTxt(inputAedat4, rightCamName, rightOutPath, "right", rectification ? &rectification->right : nullptr);
+			Log::warn("The files ", leftOutPath, ", and ", rightOutPath, " are quiet large. Consider removing them when E2VID finished the frame generation");			
 		}
 
 		return EXIT_SUCCESS;
@@ -164,15 +273,15 @@ namespace FrameGen
 
 		Log::info("Executing: ", command);
 
-		int result = std::system(command.c_str());
+		int result = Trace::runCommand("E2VID (" + datasetName + ")", command);
 		return (result == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 	}
 	
-	int recordingToVideo(const std::filesystem::path &intermediateDir, const std::filesystem::path &reconstructionDir)
+	int recordingToVideo(const std::filesystem::path &intermediateDir, const std::filesystem::path &reconstructionDir, bool rectified)
 	{
 		
-		std::filesystem::path leftTxt = intermediateDir / "leftEvents.txt";	
-		std::filesystem::path rightTxt = intermediateDir / "rightEvents.txt";	
+		std::filesystem::path leftTxt = intermediateDir / (rectified ? "leftEventsRectified.txt" : "leftEvents.txt");	
+		std::filesystem::path rightTxt = intermediateDir / (rectified ? "rightEventsRectified.txt" : "rightEvents.txt");	
 		
 		Log::info("Starting E2VID Reconstruction...");
 
@@ -192,4 +301,166 @@ namespace FrameGen
 		
 	}
 
+	int recordingToVideoOnnx(const std::vector<std::filesystem::path>& recordingFiles, const CameraMetadata& meta, const std::filesystem::path& modelPath, const std::filesystem::path& reconstructionDir, const Rectify::StereoRectification* rectification)
+	{
+#ifdef SERT_WITH_ONNXRUNTIME
+		if (!std::filesystem::exists(modelPath))
+		{
+			Log::error("Could not find E2VID ONNX model at: ", modelPath.string());
+			Log::error("Export it with src/python/export_e2vid_onnx.py.");
+			return EXIT_FAILURE;
+		}
+
+		// left and right are independent, split the cores between them
+		const int threadsPerCamera = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 2);
+
+		Log::info("Starting E2VID Reconstruction (ONNX Runtime)...");
+
+		int leftResult = EXIT_FAILURE;
+		int rightResult = EXIT_FAILURE;
+		std::thread leftThread([&]() {
+			Trace::nameThread("E2VID left");
+			leftResult = runE2VIDOnnx(recordingFiles, meta.leftCamName, modelPath, reconstructionDir, "left", threadsPerCamera, rectification ? &rectification->left : nullptr);
+		});
+		std::thread rightThread([&]() {
+			Trace::nameThread("E2VID right");
+			rightResult = runE2VIDOnnx(recordingFiles, meta.rightCamName, modelPath, reconstructionDir, "right", threadsPerCamera, rectification ? &rectification->right : nullptr);
+		});
+		leftThread.join();
+		rightThread.join();
+
+		if (leftResult != EXIT_SUCCESS)
+		{
+			Log::error("E2VID failed for left camera");
+			return EXIT_FAILURE;
+		}
+		if (rightResult != EXIT_SUCCESS)
+		{
+			Log::error("E2VID failed for right camera");
+			return EXIT_FAILURE;
+		}
+
+		Log::info("Reconstruction complete!");
+		return EXIT_SUCCESS;
+#else
+		(void)recordingFiles; (void)meta; (void)modelPath; (void)reconstructionDir; (void)rectification;
+		Log::error("sert was built without ONNX Runtime support. Reconfigure with -DSERT_WITH_ONNXRUNTIME=ON.");
+		return EXIT_FAILURE;
+#endif
+	}
+
+	WindowRenderer makeRenderer(const std::string& backend, const cv::Size& resolution, const std::filesystem::path& modelPath, int numThreads)
+	{
+		if (backend == "accumulator")
+		{
+			auto accumulator = std::make_shared<dv::Accumulator>(resolution);
+			return [accumulator](const dv::EventStore& window) {
+				accumulator->accept(window);
+				return accumulator->generateFrame().image;
+			};
+		}
+		if (backend == "onnx")
+		{
+#ifdef SERT_WITH_ONNXRUNTIME
+			try
+			{
+				auto e2vid = std::make_shared<E2VIDOnnx>(modelPath, resolution, numThreads);
+				return [e2vid](const dv::EventStore& window) {
+					return e2vid->reconstruct(window);
+				};
+			}
+			catch (const std::exception& e)
+			{
+				Log::error("Could not load E2VID ONNX model ", modelPath.string(), ": ", e.what());
+				return {};
+			}
+#else
+			(void)modelPath; (void)numThreads;
+			Log::error("sert was built without ONNX Runtime support. Reconfigure with -DSERT_WITH_ONNXRUNTIME=ON.");
+			return {};
+#endif
+		}
+		Log::error("Unknown renderer backend '", backend, "'. Options: 'accumulator', 'onnx'");
+		return {};
+	}
+
+	static int renderPreviewCamera(const std::vector<std::filesystem::path>& recordingFiles, const std::string& camName, const std::string& backend, const std::filesystem::path& modelPath, const std::filesystem::path& framesDir, const PreviewOptions& options, int numThreads, const Rectify::RectificationMap* rectification)
+	{
+		try
+		{
+			ChunkedEventReader reader(recordingFiles, camName);
+			if (!reader.isEventStreamAvailable() || !reader.getEventResolution().has_value())
+			{
+				Log::error("No event stream for camera ", camName, " in the recording");
+				return EXIT_FAILURE;
+			}
+
+			if (rectification && !rectification->checkResolution(reader.getEventResolution(), camName))
+				return EXIT_FAILURE;
+			const cv::Size sensorResolution = reader.getEventResolution().value();
+			const cv::Size resolution((sensorResolution.width + options.scale - 1) / options.scale, (sensorResolution.height + options.scale - 1) / options.scale);
+			WindowRenderer renderer = makeRenderer(backend, resolution, modelPath, numThreads);
+			if (!renderer)
+				return EXIT_FAILURE;
+
+			std::filesystem::create_directories(framesDir);
+			std::ofstream timestampsFile(framesDir / "timestamps.txt");
+
+			Trace::Span span("preview (" + framesDir.filename().string() + ")");
+			// rectification and binning run per rendered window, the skipped windows are never touched per event
+			const auto decimate = chain(RectifyTransform{rectification}, DownscaleTransform{options.scale});
+			size_t frameCount = 0;
+
+			auto renderWindow = [&](const dv::EventStore& window)
+			{
+				cv::Mat frame = renderer(decimate(window));
+
+				char fileName[32];
+				std::snprintf(fileName, sizeof(fileName), "frame_%010zu.png", frameCount);
+				cv::imwrite((framesDir / fileName).string(), frame);
+				timestampsFile << std::fixed << std::setprecision(6) << (window.getHighestTime() / 1e6) << "\n";
+				frameCount++;
+			};
+
+			WindowSink windows(static_cast<int64_t>(options.windowMs) * 1000, renderWindow, options.every);
+			runPipeline(reader, IdentityTransform{}, windows);
+
+			span.arg("frames", frameCount);
+			Log::info("[", framesDir.filename().string(), "] Preview finished, wrote ", frameCount, " frames (", resolution.width, "x", resolution.height, ")");
+			return EXIT_SUCCESS;
+		}
+		catch (const std::exception& e)
+		{
+			Log::error("Preview of camera ", camName, " failed: ", e.what());
+			return EXIT_FAILURE;
+		}
+	}
+
+	int renderPreview(const std::vector<std::filesystem::path>& recordingFiles, const CameraMetadata& meta, const std::string& backend, const std::filesystem::path& modelPath, const std::filesystem::path& previewDir, const PreviewOptions& options, const Rectify::StereoRectification* rectification)
+	{
+		Log::info("Rendering preview with '", backend, "': every ", options.every, ". window, 1/", options.scale, " resolution");
+		const int threadsPerCamera = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 2);
+
+		int leftResult = EXIT_FAILURE;
+		int rightResult = EXIT_FAILURE;
+		std::thread leftThread([&]() {
+			Trace::nameThread("preview left");
+			leftResult = renderPreviewCamera(recordingFiles, meta.leftCamName, backend, modelPath, previewDir / "left", options, threadsPerCamera, rectification ? &rectification->left : nullptr);
+		});
+		std::thread rightThread([&]() {
+			Trace::nameThread("preview right");
+			rightResult = renderPreviewCamera(recordingFiles, meta.rightCamName, backend, modelPath, previewDir / "right", options, threadsPerCamera, rectification ? &rectification->right : nullptr);
+		});
+		leftThread.join();
+		rightThread.join();
+
+		if (leftResult != EXIT_SUCCESS || rightResult != EXIT_SUCCESS)
+		{
+			Log::error("Preview failed");
+			return EXIT_FAILURE;
+		}
+		Log::info("Preview written to ", previewDir.string());
+		return EXIT_SUCCESS;
+	}
+
 }
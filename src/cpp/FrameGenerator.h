@@ -1,6 +1,16 @@
 #pragma once
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string>
+#include <vector>
+
+#include <dv-processing/core/core.hpp>
+#include <dv-processing/io/mono_camera_recording.hpp>
+#include <opencv2/core.hpp>
+
+#include "Rectifier.h"
 
 namespace FrameGen
 {
@@ -8,10 +18,57 @@ namespace FrameGen
 	{
 		std::string leftCamName, rightCamName;
 	};
+
+	// raw/chunks.txt lists the completed chunks of a rotating recording: "<file> <firstUs> <lastUs>"
+	inline constexpr const char* CHUNK_MANIFEST = "chunks.txt";
+
+	// recording files of a session in time order: the chunks from raw/chunks.txt,
+	// or the single raw/stereo_recording.aedat4; empty if there is neither
+	std::vector<std::filesystem::path> recordingFiles(const std::filesystem::path& rawDir);
+
+	// Reads the event batches of one camera across all recording files (chunks) in order
+	class ChunkedEventReader
+	{
+		public:
+			ChunkedEventReader(std::vector<std::filesystem::path> files, const std::string& camName);
+
+			bool isEventStreamAvailable() const;
+			std::optional<cv::Size> getEventResolution() const;
+			// first and last timestamp over all chunks
+			std::pair<int64_t, int64_t> getTimeRange() const;
+			std::optional<dv::EventStore> getNextEventBatch();
+
+		private:
+			std::vector<std::filesystem::path> mFiles;
+			std::string mCamName;
+			size_t mCurrentFile = 0;
+			std::unique_ptr<dv::io::MonoCameraRecording> mReader;
+	};
+
 	int environment_installed(); 
-	int convertAedat4ToTxt(const std::filesystem::path& inputAedat4, const std::filesystem::path& outputDir, const std::string& leftCamName, const std::string& rightCamName); 
+	// with a rectification the events are undistorted/rectified and written to {left,right}EventsRectified.txt
+	int convertAedat4ToTxt(const std::vector<std::filesystem::path>& inputAedat4, const std::filesystem::path& outputDir, const std::string& leftCamName, const std::string& rightCamName, const Rectify::StereoRectification* rectification = nullptr); 
 	int runE2VID(const std::filesystem::path& eventFile, const std::filesystem::path& outputDir, const std::string& datasetName);
-	int recordingToVideo(const std::filesystem::path& intermediateDir, const std::filesystem::path& reconstructionDir);
+	int recordingToVideo(const std::filesystem::path& intermediateDir, const std::filesystem::path& reconstructionDir, bool rectified = false);
+	// in-process alternative to recordingToVideo, reads the .aedat4 chunks directly and needs no conda environment
+	int recordingToVideoOnnx(const std::vector<std::filesystem::path>& recordingFiles, const CameraMetadata& meta, const std::filesystem::path& modelPath, const std::filesystem::path& reconstructionDir, const Rectify::StereoRectification* rectification = nullptr);
 	CameraMetadata readMetadata(const std::filesystem::path& directory);
+
+	// Turns one event window of a single camera into a grayscale frame, keeps its own state between windows
+	using WindowRenderer = std::function<cv::Mat(const dv::EventStore&)>;
+	// backend: 'accumulator' (native, decaying event accumulation) or 'onnx' (E2VID, needs SERT_WITH_ONNXRUNTIME)
+	// returns an empty function if the backend is unknown or cannot be created
+	WindowRenderer makeRenderer(const std::string& backend, const cv::Size& resolution, const std::filesystem::path& modelPath, int numThreads);
+
+	struct PreviewOptions
+	{
+		int scale = 2;      // spatial decimation, events are binned into scale x scale pixel blocks
+		int every = 4;      // temporal decimation, only every Nth window is reconstructed
+		int windowMs = 50;
+	};
+	// Quick look at a session: renders only every Nth window at reduced resolution with a WindowRenderer backend
+	// and writes <previewDir>/{left,right}/frame_XXXXXXXXXX.png and timestamps.txt. Skipped windows are never decoded per event.
+	// With 'onnx' the model has to be exported for the reduced resolution, a full resolution model is rejected.
+	int renderPreview(const std::vector<std::filesystem::path>& recordingFiles, const CameraMetadata& meta, const std::string& backend, const std::filesystem::path& modelPath, const std::filesystem::path& previewDir, const PreviewOptions& options, const Rectify::StereoRectification* rectification = nullptr);
 	
 }
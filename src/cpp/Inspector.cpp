@@ -0,0 +1,454 @@
+#include "Inspector.h"
+#include "FrameGenerator.h"
+#include "Log.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <dv-processing/core/core.hpp>
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace Inspect
+{
+	static constexpr int LEFT = 0;
+	static constexpr int RIGHT = 1;
+	static constexpr int64_t BIN_US = 1000;          // event rate resolution used for the clock offset
+	static constexpr int64_t REPORT_BIN_US = 1000000; // event rate resolution written to the report
+	static constexpr double HOT_PIXEL_SIGMA = 5.0;
+	static constexpr size_t MAX_REPORTED_HOT_PIXELS = 100;
+	static constexpr size_t MAX_REPORTED_GAPS = 100;
+
+	struct Block
+	{
+		int camera;
+		size_t index;
+		dv::EventStore events;
+	};
+
+	struct BlockSpan
+	{
+		size_t index;
+		int64_t first, last;
+	};
+
+	struct Gap
+	{
+		int64_t start, end;
+	};
+
+	// per worker, merged once at the end
+	struct PartialStats
+	{
+		std::vector<uint64_t> pixelCounts;
+		uint64_t onEvents = 0;
+		std::vector<BlockSpan> spans;
+		std::vector<Gap> gaps;
+	};
+
+	struct CameraStats
+	{
+		std::string name;
+		cv::Size resolution;
+		std::vector<uint64_t> pixelCounts;
+		uint64_t events = 0, onEvents = 0;
+		int64_t first = 0, last = 0;
+		std::vector<Gap> gaps;
+		std::vector<uint64_t> rate; // events per BIN_US
+	};
+
+	// single producer (the recording reader), many reducing consumers
+	class BlockQueue
+	{
+		public:
+			explicit BlockQueue(size_t capacity) : mCapacity(capacity) {}
+
+			void push(Block block)
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mNotFull.wait(lock, [&] { return mBlocks.size() < mCapacity; });
+				mBlocks.push_back(std::move(block));
+				mNotEmpty.notify_one();
+			}
+
+			bool pop(Block& block)
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mNotEmpty.wait(lock, [&] { return mClosed || !mBlocks.empty(); });
+				if (mBlocks.empty())
+					return false;
+				block = std::move(mBlocks.front());
+				mBlocks.pop_front();
+				mNotFull.notify_one();
+				return true;
+			}
+
+			void close()
+			{
+				std::scoped_lock<std::mutex> lock(mMutex);
+				mClosed = true;
+				mNotEmpty.notify_all();
+			}
+
+		private:
+			std::mutex mMutex;
+			std::condition_variable mNotEmpty, mNotFull;
+			std::deque<Block> mBlocks;
+			size_t mCapacity;
+			bool mClosed = false;
+	};
+
+	static void reduceBlock(const Block& block, const cv::Size& resolution, int64_t origin, int64_t gapUs, std::vector<std::atomic<uint32_t>>& rate, PartialStats& stats)
+	{
+		const dv::EventStore& events = block.events;
+		const int64_t first = events.getLowestTime();
+		const int64_t last = events.getHighestTime();
+		stats.spans.push_back({block.index, first, last});
+
+		// rate bins of a block are local, only flush the few touched bins to the shared histogram
+		const int64_t firstBin = (first - origin) / BIN_US;
+		const int64_t lastBin = (last - origin) / BIN_US;
+		std::vector<uint32_t> localRate(static_cast<size_t>(lastBin - firstBin + 1), 0);
+
+		int64_t previous = first;
+		uint64_t onEvents = 0;
+		for (const dv::Event& ev : events)
+		{
+			stats.pixelCounts[static_cast<size_t>(ev.y()) * resolution.width + ev.x()]++;
+			onEvents += ev.polarity();
+			localRate[static_cast<size_t>((ev.timestamp() - origin) / BIN_US - firstBin)]++;
+
+			if (ev.timestamp() - previous > gapUs)
+				stats.gaps.push_back({previous, ev.timestamp()});
+			previous = ev.timestamp();
+		}
+		stats.onEvents += onEvents;
+
+		for (size_t i = 0; i < localRate.size(); i++)
+		{
+			const int64_t bin = firstBin + static_cast<int64_t>(i);
+			if (localRate[i] > 0 && bin >= 0 && bin < static_cast<int64_t>(rate.size()))
+				rate[bin].fetch_add(localRate[i], std::memory_order_relaxed);
+		}
+	}
+
+	// normalized cross correlation of the two event rate series, lag > 0 means right is behind left
+	static std::pair<double, double> estimateClockOffset(const std::vector<uint64_t>& left, const std::vector<uint64_t>& right, int maxLagBins, int workers)
+	{
+		const size_t n = std::min(left.size(), right.size());
+		if (n < 2)
+			return {0.0, 0.0};
+
+		auto centered = [n](const std::vector<uint64_t>& series) {
+			const double mean = std::accumulate(series.begin(), series.begin() + n, 0.0) / static_cast<double>(n);
+			std::vector<double> out(n);
+			for (size_t i = 0; i < n; i++)
+				out[i] = static_cast<double>(series[i]) - mean;
+			return out;
+		};
+		const std::vector<double> l = centered(left);
+		const std::vector<double> r = centered(right);
+		const double norm = std::sqrt(std::inner_product(l.begin(), l.end(), l.begin(), 0.0) * std::inner_product(r.begin(), r.end(), r.begin(), 0.0));
+		if (norm == 0.0)
+			return {0.0, 0.0};
+
+		const int numLags = 2 * maxLagBins + 1;
+		std::vector<double> correlation(numLags, 0.0);
+		std::vector<std::thread> threads;
+		for (int w = 0; w < workers; w++)
+		{
+			threads.emplace_back([&, w]() {
+				for (int k = w; k < numLags; k += workers)
+				{
+					const int lag = k - maxLagBins;
+					const size_t begin = lag < 0 ? static_cast<size_t>(-lag) : 0;
+					const size_t end = lag > 0 ? n - static_cast<size_t>(lag) : n;
+					double sum = 0.0;
+					for (size_t i = begin; i < end; i++)
+						sum += l[i] * r[i + lag];
+					correlation[k] = sum / norm;
+				}
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+
+		const int best = static_cast<int>(std::max_element(correlation.begin(), correlation.end()) - correlation.begin());
+		double offset = best - maxLagBins;
+
+		// sub-bin refinement with a parabola through the peak and its neighbours
+		if (best > 0 && best < numLags - 1)
+		{
+			const double a = correlation[best - 1], b = correlation[best], c = correlation[best + 1];
+			const double denominator = a - 2.0 * b + c;
+			if (denominator != 0.0)
+				offset += 0.5 * (a - c) / denominator;
+		}
+		return {offset, correlation[best]};
+	}
+
+	static void writeHeatmap(const CameraStats& stats, const std::filesystem::path& file)
+	{
+		cv::Mat logCounts(stats.resolution.height, stats.resolution.width, CV_32FC1);
+		for (int y = 0; y < stats.resolution.height; y++)
+		{
+			float* row = logCounts.ptr<float>(y);
+			for (int x = 0; x < stats.resolution.width; x++)
+				row[x] = std::log1p(static_cast<float>(stats.pixelCounts[static_cast<size_t>(y) * stats.resolution.width + x]));
+		}
+		cv::Mat normalized, colored;
+		cv::normalize(logCounts, normalized, 0, 255, cv::NORM_MINMAX, CV_8UC1);
+		cv::applyColorMap(normalized, colored, cv::COLORMAP_INFERNO);
+		cv::imwrite(file.string(), colored);
+	}
+
+	static void writeCameraJson(std::ostream& out, const CameraStats& stats, int64_t origin)
+	{
+		const double duration = std::max<int64_t>(stats.last - stats.first, 1) / 1e6;
+
+		// hot pixels: far above the activity of the average pixel
+		double mean = 0.0, variance = 0.0;
+		const size_t numPixels = stats.pixelCounts.size();
+		size_t activePixels = 0;
+		for (uint64_t count : stats.pixelCounts)
+		{
+			mean += static_cast<double>(count);
+			activePixels += count > 0;
+		}
+		mean /= static_cast<double>(numPixels);
+		for (uint64_t count : stats.pixelCounts)
+			variance += (count - mean) * (count - mean);
+		const double threshold = mean + HOT_PIXEL_SIGMA * std::sqrt(variance / static_cast<double>(numPixels));
+
+		std::vector<size_t> hotPixels;
+		for (size_t i = 0; i < numPixels; i++)
+		{
+			if (static_cast<double>(stats.pixelCounts[i]) > threshold)
+				hotPixels.push_back(i);
+		}
+		std::sort(hotPixels.begin(), hotPixels.end(), [&](size_t a, size_t b) { return stats.pixelCounts[a] > stats.pixelCounts[b]; });
+
+		uint64_t peakRate = 0;
+		std::vector<uint64_t> reportRate;
+		const size_t binsPerReportBin = REPORT_BIN_US / BIN_US;
+		const size_t firstBin = static_cast<size_t>((stats.first - origin) / BIN_US);
+		const size_t lastBin = std::min(stats.rate.size(), static_cast<size_t>((stats.last - origin) / BIN_US) + 1);
+		for (size_t i = firstBin; i < lastBin; i += binsPerReportBin)
+		{
+			uint64_t sum = 0;
+			for (size_t j = i; j < std::min(i + binsPerReportBin, lastBin); j++)
+				sum += stats.rate[j];
+			reportRate.push_back(sum);
+		}
+		// peak over 100ms so single bursts do not dominate
+		const size_t peakBins = 100;
+		uint64_t windowSum = 0;
+		for (size_t i = firstBin; i < lastBin; i++)
+		{
+			windowSum += stats.rate[i];
+			if (i >= firstBin + peakBins)
+				windowSum -= stats.rate[i - peakBins];
+			peakRate = std::max(peakRate, windowSum);
+		}
+
+		out << "{\n";
+		out << "      \"name\": \"" << Trace::escapeJson(stats.name) << "\",\n";
+		out << "      \"resolution\": [" << stats.resolution.width << ", " << stats.resolution.height << "],\n";
+		out << "      \"events\": " << stats.events << ",\n";
+		out << "      \"on_ratio\": " << (stats.events ? static_cast<double>(stats.onEvents) / stats.events : 0.0) << ",\n";
+		out << "      \"first_timestamp_us\": " << stats.first << ",\n";
+		out << "      \"last_timestamp_us\": " << stats.last << ",\n";
+		out << "      \"duration_s\": " << duration << ",\n";
+		out << "      \"mean_rate_eps\": " << stats.events / duration << ",\n";
+		out << "      \"peak_rate_eps\": " << peakRate * (1000000 / (peakBins * BIN_US)) << ",\n";
+		out << "      \"active_pixels\": " << activePixels << ",\n";
+		out << "      \"hot_pixel_threshold\": " << threshold << ",\n";
+		out << "      \"hot_pixel_count\": " << hotPixels.size() << ",\n";
+		out << "      \"hot_pixels\": [";
+		for (size_t i = 0; i < std::min(hotPixels.size(), MAX_REPORTED_HOT_PIXELS); i++)
+		{
+			const size_t pixel = hotPixels[i];
+			out << (i ? ", " : "") << "[" << pixel % stats.resolution.width << ", " << pixel / stats.resolution.width << ", " << stats.pixelCounts[pixel] << "]";
+		}
+		out << "],\n";
+		out << "      \"gap_count\": " << stats.gaps.size() << ",\n";
+		out << "      \"gaps\": [";
+		for (size_t i = 0; i < std::min(stats.gaps.size(), MAX_REPORTED_GAPS); i++)
+		{
+			const Gap& gap = stats.gaps[i];
+			out << (i ? ", " : "") << "[" << (gap.start - stats.first) / 1e6 << ", " << (gap.end - gap.start) / 1e3 << "]";
+		}
+		out << "],\n";
+		out << "      \"rate_eps_per_s\": [";
+		for (size_t i = 0; i < reportRate.size(); i++)
+			out << (i ? ", " : "") << reportRate[i];
+		out << "]\n";
+		out << "    }";
+	}
+
+	int run(const std::filesystem::path& sessionDir, const Options& options)
+	{
+		std::filesystem::path rawDir = sessionDir / "raw";
+		std::filesystem::path inspectionDir = sessionDir / "inspection";
+		std::vector<std::filesystem::path> recordingFiles = FrameGen::recordingFiles(rawDir);
+
+		if (recordingFiles.empty())
+		{
+			Log::error("Could not find a recording in: ", rawDir.string());
+			return EXIT_FAILURE;
+		}
+		std::filesystem::create_directories(inspectionDir);
+
+		FrameGen::CameraMetadata meta = FrameGen::readMetadata(rawDir);
+		FrameGen::ChunkedEventReader readers[2] = {FrameGen::ChunkedEventReader(recordingFiles, meta.leftCamName), FrameGen::ChunkedEventReader(recordingFiles, meta.rightCamName)};
+
+		CameraStats cameras[2];
+		cameras[LEFT].name = meta.leftCamName;
+		cameras[RIGHT].name = meta.rightCamName;
+		for (int c : {LEFT, RIGHT})
+		{
+			if (!readers[c].isEventStreamAvailable() || !readers[c].getEventResolution().has_value())
+			{
+				Log::error("No event stream for camera ", cameras[c].name);
+				return EXIT_FAILURE;
+			}
+			cameras[c].resolution = readers[c].getEventResolution().value();
+		}
+
+		const auto leftRange = readers[LEFT].getTimeRange();
+		const auto rightRange = readers[RIGHT].getTimeRange();
+		const int64_t origin = std::min(leftRange.first, rightRange.first);
+		const size_t numBins = static_cast<size_t>((std::max(leftRange.second, rightRange.second) - origin) / BIN_US + 1);
+		std::vector<std::atomic<uint32_t>> rate[2] = {std::vector<std::atomic<uint32_t>>(numBins), std::vector<std::atomic<uint32_t>>(numBins)};
+
+		const int workers = options.workers > 0 ? options.workers : std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+		const int64_t gapUs = static_cast<int64_t>(options.gapMs) * 1000;
+
+		Log::info("Inspecting ", rawDir.string(), " (", recordingFiles.size(), " file(s), ", (numBins * BIN_US) / 1e6, "s) with ", workers, " workers...");
+
+		// workers reduce blocks into private partial stats, no locking on the per-event path
+		std::optional<Trace::Span> readSpan(std::in_place, "read + reduce");
+		BlockQueue queue(static_cast<size_t>(workers) * 4);
+		std::vector<std::array<PartialStats, 2>> partials(workers);
+		std::vector<std::thread> threads;
+		for (int w = 0; w < workers; w++)
+		{
+			for (int c : {LEFT, RIGHT})
+				partials[w][c].pixelCounts.assign(static_cast<size_t>(cameras[c].resolution.area()), 0);
+
+			threads.emplace_back([&, w]() {
+				Block block;
+				while (queue.pop(block))
+					reduceBlock(block, cameras[block.camera].resolution, origin, gapUs, rate[block.camera], partials[w][block.camera]);
+			});
+		}
+
+		// the reader decodes sequentially, alternating cameras so both advance through the file together
+		size_t blockIndex[2] = {0, 0};
+		bool finished[2] = {false, false};
+		while (!finished[LEFT] || !finished[RIGHT])
+		{
+			for (int c : {LEFT, RIGHT})
+			{
+				if (finished[c])
+					continue;
+				auto events = readers[c].getNextEventBatch();
+				if (!events.has_value())
+				{
+					finished[c] = true;
+					continue;
+				}
+				if (!events->isEmpty())
+					queue.push({c, blockIndex[c]++, std::move(*events)});
+			}
+		}
+		queue.close();
+		for (auto& thread : threads)
+			thread.join();
+		readSpan.reset();
+
+		// merge
+		Trace::Span reportSpan("merge + report");
+		for (int c : {LEFT, RIGHT})
+		{
+			CameraStats& stats = cameras[c];
+			stats.pixelCounts.assign(static_cast<size_t>(stats.resolution.area()), 0);
+			std::vector<BlockSpan> spans;
+			for (auto& partial : partials)
+			{
+				for (size_t i = 0; i < stats.pixelCounts.size(); i++)
+					stats.pixelCounts[i] += partial[c].pixelCounts[i];
+				stats.onEvents += partial[c].onEvents;
+				spans.insert(spans.end(), partial[c].spans.begin(), partial[c].spans.end());
+				stats.gaps.insert(stats.gaps.end(), partial[c].gaps.begin(), partial[c].gaps.end());
+			}
+			stats.events = std::accumulate(stats.pixelCounts.begin(), stats.pixelCounts.end(), uint64_t{0});
+
+			// gaps across block boundaries need the blocks in file order
+			std::sort(spans.begin(), spans.end(), [](const BlockSpan& a, const BlockSpan& b) { return a.index < b.index; });
+			for (size_t i = 1; i < spans.size(); i++)
+			{
+				if (spans[i].first - spans[i - 1].last > gapUs)
+					stats.gaps.push_back({spans[i - 1].last, spans[i].first});
+			}
+			std::sort(stats.gaps.begin(), stats.gaps.end(), [](const Gap& a, const Gap& b) { return a.start < b.start; });
+
+			if (!spans.empty())
+			{
+				stats.first = spans.front().first;
+				stats.last = spans.back().last;
+			}
+			stats.rate.resize(numBins);
+			for (size_t i = 0; i < numBins; i++)
+				stats.rate[i] = rate[c][i].load(std::memory_order_relaxed);
+		}
+
+		const auto [clockOffsetBins, clockCorrelation] = estimateClockOffset(cameras[LEFT].rate, cameras[RIGHT].rate, options.maxLagMs * 1000 / static_cast<int>(BIN_US), workers);
+
+		writeHeatmap(cameras[LEFT], inspectionDir / "heatmap_left.png");
+		writeHeatmap(cameras[RIGHT], inspectionDir / "heatmap_right.png");
+
+		std::ofstream report(inspectionDir / "report.json");
+		report << std::setprecision(10);
+		report << "{\n";
+		report << "  \"recording\": \"" << Trace::escapeJson(rawDir.string()) << "\",\n";
+		report << "  \"files\": " << recordingFiles.size() << ",\n";
+		report << "  \"cameras\": {\n";
+		report << "    \"left\": ";
+		writeCameraJson(report, cameras[LEFT], origin);
+		report << ",\n    \"right\": ";
+		writeCameraJson(report, cameras[RIGHT], origin);
+		report << "\n  },\n";
+		report << "  \"stereo\": {\n";
+		report << "    \"start_offset_us\": " << cameras[RIGHT].first - cameras[LEFT].first << ",\n";
+		report << "    \"end_offset_us\": " << cameras[RIGHT].last - cameras[LEFT].last << ",\n";
+		report << "    \"clock_offset_us\": " << clockOffsetBins * BIN_US << ",\n";
+		report << "    \"clock_offset_correlation\": " << clockCorrelation << "\n";
+		report << "  }\n";
+		report << "}\n";
+		report.close();
+
+		for (int c : {LEFT, RIGHT})
+		{
+			const CameraStats& stats = cameras[c];
+			Log::info(c == LEFT ? "Left:  " : "Right: ", stats.events, " events, ", (stats.last - stats.first) / 1e6, "s, ", stats.gaps.size(), " gaps > ", options.gapMs, "ms");
+		}
+		Log::info("Estimated stereo clock offset: ", clockOffsetBins * BIN_US, "us (correlation ", clockCorrelation, ")");
+		Log::info("Inspection written to ", inspectionDir.string());
+		return EXIT_SUCCESS;
+	}
+}
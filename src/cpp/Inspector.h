@@ -0,0 +1,15 @@
+#pragma once
+#include <filesystem>
+
+namespace Inspect
+{
+	struct Options
+	{
+		int gapMs = 20;      // silences longer than this are reported as time gaps
+		int maxLagMs = 50;   // search range for the stereo clock offset
+		int workers = 0;     // reduction threads, 0 = hardware concurrency - 1
+	};
+
+	// Reads <session>/raw once and writes <session>/inspection/report.json and heatmap_{left,right}.png
+	int run(const std::filesystem::path& sessionDir, const Options& options);
+}
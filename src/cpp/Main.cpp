@@ -3,11 +3,15 @@
 #include <cstdlib>
 #include <string>
 #include <fstream>
+#include <optional>
 
 #include "Log.h"
 #include "Recorder.h"
 #include "FrameGenerator.h"
 #include "Calibrator.h"
+#include "Inspector.h"
+#include "StereoDepth.h"
+#include "Tracer.h"
 
 void logUsage(char* argv[]);
 
@@ -39,14 +43,43 @@ int main (int argc, char *argv[])
 	std::signal(SIGINT, signalHandler);
 	std::signal(SIGTERM, signalHandler);
 
+	for (int i = 2; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--no-trace")
+			Trace::setEnabled(false);
+	}
+
 	if (command == "render")
 	{
 		std::string sessionPathStr;
+		std::string backend = "python";
+		bool rectify = false;
+		bool preview = false;
+		FrameGen::PreviewOptions previewOptions;
+		std::filesystem::path modelPath = std::filesystem::path(PROJECT_ROOT_DIR) / "rpg_e2vid" / "pretrained" / "E2VID_lightweight.onnx";
 
         for (int i = 2; i < argc; ++i) 
 		{
             std::string arg = argv[i];
             if ((arg == "-s" || arg == "--session") && i + 1 < argc) sessionPathStr = argv[++i];
+            if ((arg == "-b" || arg == "--backend") && i + 1 < argc) backend = argv[++i];
+            if ((arg == "-m" || arg == "--model") && i + 1 < argc) modelPath = argv[++i];
+            if (arg == "-r" || arg == "--rectify") rectify = true;
+            if (arg == "--preview") preview = true;
+            if ((arg == "--scale" || arg == "--every") && i + 1 < argc)
+			{
+				try 
+				{
+					int value = std::stoi(argv[++i]);
+					if (value <= 0)
+						throw std::invalid_argument("must be positive");
+					(arg == "--scale" ? previewOptions.scale : previewOptions.every) = value;
+				} catch (const std::exception& e) 
+				{
+					Log::error("Invalid value for ", arg, ": ", e.what());
+                    return EXIT_FAILURE;
+				}
+			}
         }
 
 		if (sessionPathStr.empty())
@@ -55,6 +88,13 @@ int main (int argc, char *argv[])
 			logUsage(argv);
 			return EXIT_FAILURE;
 		}
+
+		if (backend != "python" && backend != "onnx")
+		{
+			Log::error("Error: Unknown render backend '", backend, "'. Options: 'python', 'onnx'");
+			logUsage(argv);
+			return EXIT_FAILURE;
+		}
 		
 		std::filesystem::path sessionDir(sessionPathStr);
 		std::filesystem::path rawDir = sessionDir / "raw";
@@ -66,35 +106,188 @@ int main (int argc, char *argv[])
 			Log::error("Invalid session: 'raw' directory missing in ", sessionDir.string());
 			return EXIT_FAILURE;
 		}
+		Trace::Session trace(sessionDir, command);
 
 		std::filesystem::create_directories(intermediateDir);
 		std::filesystem::create_directories(reconstructionDir);
 
 		FrameGen::CameraMetadata meta = FrameGen::readMetadata(rawDir);
 
-		std::filesystem::path recordingFile = rawDir / "stereo_recording.aedat4";
-		if (FrameGen::convertAedat4ToTxt(recordingFile, intermediateDir, meta.leftCamName, meta.rightCamName) != EXIT_SUCCESS)
+		// rectified frames go to their own folder, Kalibr still needs the raw ones
+		std::optional<Rectify::StereoRectification> rectification;
+		if (rectify)
+		{
+			Trace::Span span("load rectification");
+			rectification = Rectify::loadStereoRectification(sessionDir / "calibration");
+			if (!rectification.has_value())
+			{
+				Log::error("Could not load the stereo rectification. Aborting...");
+				return EXIT_FAILURE;
+			}
+			reconstructionDir /= "rectified";
+			std::filesystem::create_directories(reconstructionDir);
+		}
+		const Rectify::StereoRectification* rectificationPtr = rectification ? &*rectification : nullptr;
+
+		std::vector<std::filesystem::path> recordingFiles = FrameGen::recordingFiles(rawDir);
+		if (recordingFiles.empty())
+		{
+			Log::error("Invalid session: no recording found in ", rawDir.string());
+			return EXIT_FAILURE;
+		}
+		if (preview)
+		{
+			// the preview renders in-process, the python backend would need the full .txt export first
+			return FrameGen::renderPreview(recordingFiles, meta, backend == "onnx" ? "onnx" : "accumulator", modelPath, reconstructionDir / "preview", previewOptions, rectificationPtr);
+		}
+		if (backend == "onnx")
+		{
+			if (FrameGen::recordingToVideoOnnx(recordingFiles, meta, modelPath, reconstructionDir, rectificationPtr) != EXIT_SUCCESS)
+			{
+				Log::error("E2VID reconstruction failed. Aborting...");
+				return EXIT_FAILURE;
+			}
+			return EXIT_SUCCESS;
+		}
+
+		if (FrameGen::convertAedat4ToTxt(recordingFiles, intermediateDir, meta.leftCamName, meta.rightCamName, rectificationPtr) != EXIT_SUCCESS)
 		{
 			Log::error("Could not convert .aedat4 to .txt for further E2VID reconstruction. Aborting...");	
 			return EXIT_FAILURE;
 		}
-		if (FrameGen::recordingToVideo(intermediateDir, reconstructionDir) != EXIT_SUCCESS)
+		if (FrameGen::recordingToVideo(intermediateDir, reconstructionDir, rectify) != EXIT_SUCCESS)
 		{
 			Log::error("E2VID reconstruction failed. Aborting...");
 			return EXIT_FAILURE;
 		}
 	}
-	else if (command == "record")
+	else if (command == "inspect")
+	{
+		std::string sessionPathStr;
+		Inspect::Options options;
+
+        for (int i = 2; i < argc; ++i) 
+		{
+            std::string arg = argv[i];
+            if ((arg == "-s" || arg == "--session") && i + 1 < argc) sessionPathStr = argv[++i];
+            if ((arg == "-g" || arg == "--gap") && i + 1 < argc)
+			{
+				try 
+				{
+					options.gapMs = std::stoi(argv[++i]);
+					// every silence would become a gap, that does not fit into memory for long recordings
+					if (options.gapMs <= 0)
+						throw std::invalid_argument("must be positive");
+				} catch (const std::exception& e) 
+				{
+					Log::error("Invalid value for ", arg, ": ", e.what());
+                    return EXIT_FAILURE;
+				}
+			}
+        }
+
+		if (sessionPathStr.empty())
+		{
+			Log::error("Error: inspect requires -s (session path).");
+			logUsage(argv);
+			return EXIT_FAILURE;
+		}
+
+		Trace::Session trace(sessionPathStr, command);
+		return Inspect::run(std::filesystem::path(sessionPathStr), options);
+	}
+	else if (command == "esvo")
+	{
+		std::string sessionPathStr;
+		Depth::Options options;
+
+        for (int i = 2; i < argc; ++i) 
+		{
+            std::string arg = argv[i];
+            if ((arg == "-s" || arg == "--session") && i + 1 < argc) sessionPathStr = argv[++i];
+            if (arg == "--pcd") options.writePointClouds = true;
+            if ((arg == "-w" || arg == "--window" || arg == "-d" || arg == "--disparities") && i + 1 < argc)
+			{
+				try 
+				{
+					int value = std::stoi(argv[++i]);
+					if (value <= 0)
+						throw std::invalid_argument("must be positive");
+					(arg == "-w" || arg == "--window" ? options.windowMs : options.maxDisparity) = value;
+				} catch (const std::exception& e) 
+				{
+					Log::error("Invalid value for ", arg, ": ", e.what());
+                    return EXIT_FAILURE;
+				}
+			}
+        }
+
+		if (sessionPathStr.empty())
+		{
+			Log::error("Error: esvo requires -s (session path).");
+			logUsage(argv);
+			return EXIT_FAILURE;
+		}
+
+		Trace::Session trace(sessionPathStr, command);
+		return Depth::run(std::filesystem::path(sessionPathStr), options);
+	}
+	else if (command == "record" || command == "live")
 	{		
 		std::string pathString;
 		std::string sessionName = "session_" + getCurrentTimestamp();
 		bool visualize = false;
+		StereoRecorder::LiveOptions liveOptions;
+		liveOptions.modelPath = std::filesystem::path(PROJECT_ROOT_DIR) / "rpg_e2vid" / "pretrained" / "E2VID_lightweight.onnx";
 		for (int i = 2; i < argc; ++i)
 		{
 			std::string arg = argv[i];
 
 			if(arg == "-v" || arg == "--visualize") 
+			{
+				// live always shows its rendered frames, the event preview would only compete for the main thread
+				if (command == "live")
+				{
+					Log::error("Error: ", arg, " is not available for live, the live windows replace it.");
+					logUsage(argv);
+					return EXIT_FAILURE;
+				}
 				visualize = true;
+			}
+
+			else if (command == "live" && (arg == "-b" || arg == "--backend") && i + 1 < argc)
+				liveOptions.backend = argv[++i];
+			else if (command == "live" && (arg == "-m" || arg == "--model") && i + 1 < argc)
+				liveOptions.modelPath = argv[++i];
+			else if (command == "live" && arg == "--save")
+				liveOptions.saveFrames = true;
+			else if ((command == "live" && (arg == "-w" || arg == "--window" || arg == "-l" || arg == "--latency")) || arg == "--chunk-seconds" || arg == "--chunk-mb")
+			{
+				if (i + 1 >= argc)
+				{
+					Log::error("Error: ", arg," flag requires a value.");
+                    logUsage(argv);
+                    return EXIT_FAILURE;		
+				}
+				try 
+				{
+					int value = std::stoi(argv[++i]);
+					if (value <= 0)
+						throw std::invalid_argument("must be positive");
+					if (arg == "-w" || arg == "--window")
+						liveOptions.windowMs = value;
+					else if (arg == "-l" || arg == "--latency")
+						liveOptions.latencyBudgetMs = value;
+					else if (arg == "--chunk-seconds")
+						liveOptions.chunks.maxSeconds = value;
+					else
+						liveOptions.chunks.maxMegabytes = value;
+				} catch (const std::exception& e) 
+				{
+					Log::error("Invalid value for ", arg, ": ", e.what());
+                    return EXIT_FAILURE;
+				}
+			}
 
 			else if (arg == "-p" || arg == "--path")
 			{
@@ -147,11 +340,15 @@ int main (int argc, char *argv[])
 			Log::error("Failed to create session directories: ", e.what());
 			return EXIT_FAILURE;
 		}
+		Trace::Session trace(sessionDir, command);
 		
+		if (command == "live")
+			return StereoRecorder::live(sessionDir, liveOptions, stopSignal);
+
 		if (visualize) 
 			Log::info("Visualization enabled.");
 
-		return StereoRecorder::record(rawDir, visualize, stopSignal);	
+		return StereoRecorder::record(rawDir, visualize, stopSignal, liveOptions.chunks);	
 	}
 	else if (command == "calibrate")
 	{
@@ -233,6 +430,7 @@ int main (int argc, char *argv[])
 		std::filesystem::create_directories(calibrationDir);
 
 		Log::info("Initialized config/ and calibration/ directories for session: ", sessionPathStr);
+		Trace::Session trace(sessionDir, command);
 
 		if (!targetType.empty() && configProvided)
 		{
@@ -294,17 +492,42 @@ void logUsage(char* argv[])
 
         "Commands:\n",
         "  record       Creates a timestamped session in <path> and saves raw .aedat4 data\n",
+        "  live         Records like 'record' and renders frames from the incoming events in real time\n",
+        "  inspect      Writes event statistics, heatmaps, hot pixels and time gaps of a session to <session>/inspection/\n",
         "  render       Processes raw data into frames/bags within the session directory\n",
         "  calibrate    Computes intrinsics/extrinsics from frames and updates session config\n",
         "  esvo         Runs 3D reconstruction and saves results to the session's esvo/ folder\n\n",
 
+        "All commands that work on a session write a Chrome/Perfetto trace to <session>/traces/, --no-trace turns this off.\n\n",
+
         "record Options:\n",
         "  -p, --path <dir>      (Required) Parent directory where 'session_YYYY-MM-DD..' or 'session_<name>' (if -n is provided) is created\n",
 		"  -n, --name            (Optional) gives the session a name instead of the YYYY-MM-DD_H_M_S suffix\n",
-        "  -v, --visualize       (Optional) Enable live preview window\n\n",
+        "  -v, --visualize       (Optional) Enable live preview window\n",
+        "      --chunk-seconds <s>   (Optional) Start a new raw/stereo_recording_NNNN.aedat4 chunk every <s> seconds\n",
+        "      --chunk-mb <MB>       (Optional) Start a new chunk once the current one reaches <MB> megabytes\n\n",
+
+        "live Options:\n",
+        "  -p, --path / -n, --name, --chunk-seconds, --chunk-mb   Same as for record (-v is not available, the live windows replace it)\n",
+        "  -b, --backend <name>  (Optional) Renderer: 'accumulator' (default) or 'onnx' (E2VID, in-process)\n",
+        "  -m, --model <file>    (Optional) ONNX model for the 'onnx' backend\n",
+        "  -w, --window <ms>     (Optional) Window duration per frame (default: 50)\n",
+        "  -l, --latency <ms>    (Optional) Latency budget, older windows are dropped (default: 250)\n",
+        "      --save            (Optional) Also write the frames to <session>/reconstruction/live/\n\n",
+
+        "inspect Options:\n",
+        "  -s, --session <dir>   (Required) Path to the session folder\n",
+        "  -g, --gap <ms>        (Optional) Report silences longer than this as time gaps (default: 20)\n\n",
 
         "render Options:\n",
-        "  -s, --session <dir>   (Required) Path to the specific session folder to process\n\n",
+        "  -s, --session <dir>   (Required) Path to the specific session folder to process\n",
+        "  -b, --backend <name>  (Optional) E2VID backend: 'python' (conda, default) or 'onnx' (in-process, CPU)\n",
+        "  -m, --model <file>    (Optional) ONNX model for the 'onnx' backend (default: rpg_e2vid/pretrained/E2VID_lightweight.onnx)\n",
+        "  -r, --rectify         (Optional) Undistort/rectify events with the session's Kalibr camchain, outputs to reconstruction/rectified/\n",
+        "      --preview         (Optional) Fast low-resolution preview of every Nth window to reconstruction/[rectified/]preview/ (accumulator, or E2VID with -b onnx\n"
+        "                        and -m <model exported for the preview resolution>)\n",
+        "      --scale <n>       (Optional) Preview resolution divisor (default: 2)\n",
+        "      --every <n>       (Optional) Preview only every nth 50ms window (default: 4)\n\n",
 
         "calibrate Options:\n",
         "  -s, --session <dir>   (Required) Path to the session folder (outputs to /calibration/ and /config/)\n",
@@ -318,7 +541,10 @@ void logUsage(char* argv[])
 		"    For further explanation of the targets and its configs, visit: https://github.com/ethz-asl/kalibr/wiki/calibration-targets\n\n"
 
         "esvo Options:\n",
-        "  -s, --session <dir>   (Required) Path to the session folder (outputs to /esvo/)\n\n",
+        "  -s, --session <dir>   (Required) Path to the session folder (outputs to /esvo/, needs a calibrated session)\n",
+        "  -w, --window <ms>     (Optional) One depth map per window (default: 50)\n",
+        "  -d, --disparities <n> (Optional) Maximum disparity in pixels (default: 64)\n",
+        "      --pcd             (Optional) Also write one point cloud per window to /esvo/pointclouds/\n\n",
 
 		"For more information about the session structure, take a look at https://github.com/patrickhln/stereo-event-reconstruction-tool README.md\n"
     );
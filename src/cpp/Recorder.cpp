@@ -1,9 +1,16 @@
 #include "Recorder.h"
+#include "FrameGenerator.h"
 #include "Log.h"
+#include "Tracer.h"
 
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <optional>
+#include <utility>
 
 
 #include <dv-processing/core/core.hpp>
@@ -16,6 +23,7 @@
 #include <dv-processing/io/data_read_handler.hpp>
 
 #include <opencv2/highgui.hpp>
+#include <opencv2/imgcodecs.hpp>
 
 namespace StereoRecorder
 {
@@ -25,9 +33,10 @@ namespace StereoRecorder
 		std::shared_ptr<const dv::EventStore> right;
 	};
 
-	int record(const std::filesystem::path &rawDir, bool showVisualization, std::atomic<bool>& stopSignal)
-	{
+	using CameraPtr = std::unique_ptr<dv::io::camera::SyncCameraInputBase>;
 
+	static std::pair<CameraPtr, CameraPtr> openStereoCameras()
+	{
 		const auto cameras = dv::io::camera::discover();
 
 		const size_t num_cameras = cameras.size();
@@ -53,7 +62,11 @@ namespace StereoRecorder
 		else
 			throw dv::exceptions::RuntimeError("No clock syncronization master was detected");
 
+		return {std::move(leftCamera), std::move(rightCamera)};
+	}
 
+	static void writeCameraMetadata(const std::filesystem::path &rawDir, const CameraPtr &leftCamera, const CameraPtr &rightCamera)
+	{
 		// temporal, change to consistent load function
 		std::filesystem::path camMetaFilePath = rawDir / "camera_metadata.txt";
 		std::ofstream camMetadataStream(camMetaFilePath);
@@ -89,9 +102,180 @@ namespace StereoRecorder
 			std::filesystem::perms::others_write,
 			std::filesystem::perm_options::remove
 		);
+	}
+
+	// Hands a batch from a camera handler to a consumer thread without ever blocking the handler for long.
+	// When the consumer falls behind, the two oldest batches are merged (mergeWhenFull) or the oldest is dropped.
+	static void pushBounded(std::deque<std::shared_ptr<const dv::EventStore>> &queue, std::shared_ptr<const dv::EventStore> batch, size_t maxSize, bool mergeWhenFull, size_t &overflowCount)
+	{
+		if (queue.size() >= maxSize)
+		{
+			overflowCount++;
+			if (mergeWhenFull && queue.size() >= 2)
+			{
+				auto merged = std::make_shared<dv::EventStore>(*queue[0]);
+				merged->add(*queue[1]);
+				queue.pop_front();
+				queue.front() = std::move(merged);
+			}
+			else
+			{
+				queue.pop_front();
+			}
+		}
+		queue.push_back(std::move(batch));
+	}
+
+	// Writes the stereo recording, either to one stereo_recording.aedat4 or in chunks (see ChunkOptions).
+	// Only used from the recording thread, so no locking is needed around the writer.
+	// IMU and trigger packets are written by their handlers right away. handleNext calls the handlers on the
+	// recording thread too, so they share the writer with the events and their (small) writes happen inline.
+	// Their timestamps are the device timestamps, already synchronized to the clock master like the events.
+	class StereoRecordingWriter
+	{
+		public:
+			StereoRecordingWriter(const std::filesystem::path &rawDir, const dv::io::camera::SyncCameraInputBase &leftCamera, const dv::io::camera::SyncCameraInputBase &rightCamera, const ChunkOptions &options) :
+				mRawDir(rawDir), mLeftCamera(leftCamera), mRightCamera(rightCamera), mOptions(options)
+			{
+				if (mOptions.enabled())
+				{
+					std::ofstream manifest(mRawDir / FrameGen::CHUNK_MANIFEST);
+					manifest << "Do not change or remove this file!\n";
+					Log::info("Recording in chunks of max ", mOptions.maxSeconds, "s / ", mOptions.maxMegabytes, "MB (0 = unlimited)");
+				}
+				openChunk();
+			}
 
-		std::filesystem::path out = rawDir / "stereo_recording.aedat4";
-		dv::io::StereoCameraWriter writer(out.string(), *leftCamera, *rightCamera);
+			~StereoRecordingWriter()
+			{
+				closeChunk();
+			}
+
+			// routes the IMU and trigger streams of a camera (if it has them) into the recording
+			void captureAuxiliary(dv::io::DataReadHandler &handler, const dv::io::camera::SyncCameraInputBase &camera, bool left)
+			{
+				if (camera.isImuStreamAvailable())
+				{
+					handler.mImuHandler = [this, left](const dv::cvector<dv::IMU> &imu)
+					{
+						if (imu.empty())
+							return;
+						dv::IMUPacket packet;
+						packet.elements = imu;
+						(left ? mWriter->left : mWriter->right).writeImuPacket(packet);
+					};
+				}
+				if (camera.isTriggerStreamAvailable())
+				{
+					handler.mTriggersHandler = [this, left](const dv::cvector<dv::Trigger> &triggers)
+					{
+						if (triggers.empty())
+							return;
+						dv::TriggerPacket packet;
+						packet.elements = triggers;
+						(left ? mWriter->left : mWriter->right).writeTriggerPacket(packet);
+					};
+				}
+				Log::info(camera.getCameraName(), ": IMU ", camera.isImuStreamAvailable() ? "on" : "n/a", ", triggers ", camera.isTriggerStreamAvailable() ? "on" : "n/a");
+			}
+
+			void writeEvents(bool left, const dv::EventStore &events)
+			{
+				if (events.isEmpty())
+					return;
+				(left ? mWriter->left : mWriter->right).writeEvents(events);
+				if (mChunkStart < 0)
+					mChunkStart = events.getLowestTime();
+				mChunkEnd = std::max(mChunkEnd, events.getHighestTime());
+			}
+
+			// call between packets only, then both cameras' streams end on a clean boundary
+			void rollOverIfNeeded()
+			{
+				if (!mOptions.enabled() || mChunkStart < 0)
+					return;
+
+				bool full = mOptions.maxSeconds > 0 && mChunkEnd - mChunkStart >= static_cast<int64_t>(mOptions.maxSeconds) * 1000000;
+
+				// the file size lags behind (buffered, compressed), an approximate limit is fine
+				if (!full && mOptions.maxMegabytes > 0 && ++mPacketsSinceSizeCheck >= 100)
+				{
+					mPacketsSinceSizeCheck = 0;
+					std::error_code error;
+					const auto size = std::filesystem::file_size(mCurrentFile, error);
+					full = !error && size >= static_cast<uintmax_t>(mOptions.maxMegabytes) * 1024 * 1024;
+				}
+
+				if (full)
+				{
+					closeChunk();
+					openChunk();
+				}
+			}
+
+		private:
+			void openChunk()
+			{
+				if (mOptions.enabled())
+				{
+					char fileName[48];
+					std::snprintf(fileName, sizeof(fileName), "stereo_recording_%04zu.aedat4", mChunkIndex);
+					mCurrentFile = mRawDir / fileName;
+				}
+				else
+				{
+					mCurrentFile = mRawDir / "stereo_recording.aedat4";
+				}
+				mWriter = std::make_unique<dv::io::StereoCameraWriter>(mCurrentFile.string(), mLeftCamera, mRightCamera);
+				mChunkStart = -1;
+				mChunkEnd = -1;
+				mPacketsSinceSizeCheck = 0;
+			}
+
+			void closeChunk()
+			{
+				if (!mWriter)
+					return;
+				// destroying the writer flushes and finalizes the file
+				mWriter.reset();
+
+				if (!mOptions.enabled())
+					return;
+
+				if (mChunkStart < 0)
+				{
+					std::filesystem::remove(mCurrentFile);
+					return;
+				}
+
+				// a chunk is only listed once it is complete, readers may pick it up right away
+				std::ofstream manifest(mRawDir / FrameGen::CHUNK_MANIFEST, std::ios::app);
+				manifest << mCurrentFile.filename().string() << " " << mChunkStart << " " << mChunkEnd << "\n";
+				manifest.close();
+				Log::info("Finished chunk ", mCurrentFile.filename().string(), " (", (mChunkEnd - mChunkStart) / 1e6, "s)");
+				mChunkIndex++;
+			}
+
+			std::filesystem::path mRawDir;
+			const dv::io::camera::SyncCameraInputBase &mLeftCamera;
+			const dv::io::camera::SyncCameraInputBase &mRightCamera;
+			ChunkOptions mOptions;
+
+			std::unique_ptr<dv::io::StereoCameraWriter> mWriter;
+			std::filesystem::path mCurrentFile;
+			size_t mChunkIndex = 0;
+			int64_t mChunkStart = -1, mChunkEnd = -1;
+			size_t mPacketsSinceSizeCheck = 0;
+	};
+
+	int record(const std::filesystem::path &rawDir, bool showVisualization, std::atomic<bool>& stopSignal, const ChunkOptions &chunks)
+	{
+		auto cameras = openStereoCameras();
+		CameraPtr &leftCamera = cameras.first;
+		CameraPtr &rightCamera = cameras.second;
+		writeCameraMetadata(rawDir, leftCamera, rightCamera);
+
+		StereoRecordingWriter writer(rawDir, *leftCamera, *rightCamera, chunks);
 
 		std::mutex queueMutex;
 		std::condition_variable visQueueCondition;
@@ -103,13 +287,13 @@ namespace StereoRecorder
 		// Example for usage of the DataReadHandler Class:
 		// https://gitlab.com/inivation/dv/dv-processing/-/blob/master/samples/io/stereo-live-writer/stereo-live-writer.cpp#L26
 		dv::io::DataReadHandler leftHandler, rightHandler;
-
-		// TODO: ADD IMU for Kalibr
+		writer.captureAuxiliary(leftHandler, *leftCamera, true);
+		writer.captureAuxiliary(rightHandler, *rightCamera, false);
 
 		leftHandler.mEventHandler = [&](const dv::EventStore &events) 
 		{
 			// Priority 1: write events
-			writer.left.writeEvents(events);	
+			writer.writeEvents(true, events);	
 
 			// Priority 2: send events to visualization thread 
 			if (showVisualization)
@@ -117,33 +301,21 @@ namespace StereoRecorder
 				auto leftEventPtr = std::make_shared<dv::EventStore>(events);		
 				{
 					std::scoped_lock<std::mutex> lock(queueMutex);
-					
-					if (leftQueue.size() >= MAX_QUEUE_SIZE)
-					{
-						droppedVisFrames++;
-						leftQueue.pop_front();
-					}
-					leftQueue.push_back(std::move(leftEventPtr));
+					pushBounded(leftQueue, std::move(leftEventPtr), MAX_QUEUE_SIZE, false, droppedVisFrames);
 				}
 				visQueueCondition.notify_one();
 			}
 		};
 		rightHandler.mEventHandler = [&](const dv::EventStore &events) 
 		{
-			writer.right.writeEvents(events);	
+			writer.writeEvents(false, events);	
 
 			if (showVisualization)
 			{
 				auto rightEventPtr = std::make_shared<dv::EventStore>(events);		
 				{
 					std::scoped_lock<std::mutex> lock(queueMutex);
-					
-					if (rightQueue.size() >= MAX_QUEUE_SIZE)
-					{
-						droppedVisFrames++;
-						rightQueue.pop_front();
-					}
-					rightQueue.push_back(std::move(rightEventPtr));
+					pushBounded(rightQueue, std::move(rightEventPtr), MAX_QUEUE_SIZE, false, droppedVisFrames);
 				}
 				visQueueCondition.notify_one();
 			}
@@ -152,11 +324,14 @@ namespace StereoRecorder
 
 		// recording (producer) thread
 		std::thread recordingThread([&]() {
+			Trace::nameThread("recording");
+			Trace::Span span("recording");
 			Log::info("Starting the recording!");
 			while (!stopSignal.load() && leftCamera->isRunning() && rightCamera->isRunning())
 			{
 				if (!leftCamera->handleNext(leftHandler)) break;
 				if (!rightCamera->handleNext(rightHandler)) break;
+				writer.rollOverIfNeeded();
 			}
 			visQueueCondition.notify_all();
 			Log::info("Recording Thread Finished");
@@ -236,4 +411,355 @@ namespace StereoRecorder
 		return EXIT_SUCCESS;
 
 	}
+
+	// Renders the windows of one camera on a long-lived thread, one window at a time (submit, then wait)
+	class RenderWorker
+	{
+		public:
+			RenderWorker(FrameGen::WindowRenderer renderer, std::string name) : mRenderer(std::move(renderer)), mName(std::move(name)), mThread([this]() { loop(); })
+			{
+			}
+
+			~RenderWorker()
+			{
+				{
+					std::scoped_lock<std::mutex> lock(mMutex);
+					mStop = true;
+				}
+				mCondition.notify_all();
+				mThread.join();
+			}
+
+			// the window has to stay alive until wait() returns
+			void submit(const dv::EventStore &window)
+			{
+				{
+					std::scoped_lock<std::mutex> lock(mMutex);
+					mWindow = &window;
+					mDone = false;
+				}
+				mCondition.notify_all();
+			}
+
+			cv::Mat wait()
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mCondition.wait(lock, [&]{ return mDone; });
+				if (mError)
+					std::rethrow_exception(std::exchange(mError, nullptr));
+				return std::move(mFrame);
+			}
+
+		private:
+			void loop()
+			{
+				Trace::nameThread(mName);
+				std::unique_lock<std::mutex> lock(mMutex);
+				while (true)
+				{
+					mCondition.wait(lock, [&]{ return mStop || mWindow != nullptr; });
+					if (mStop)
+						return;
+					const dv::EventStore *window = std::exchange(mWindow, nullptr);
+					lock.unlock();
+
+					cv::Mat frame;
+					std::exception_ptr error;
+					try
+					{
+						frame = mRenderer(*window);
+					}
+					catch (...)
+					{
+						error = std::current_exception();
+					}
+
+					lock.lock();
+					mFrame = std::move(frame);
+					mError = error;
+					mDone = true;
+					mCondition.notify_all();
+				}
+			}
+
+			FrameGen::WindowRenderer mRenderer;
+			std::string mName;
+			std::mutex mMutex;
+			std::condition_variable mCondition;
+			const dv::EventStore *mWindow = nullptr;
+			cv::Mat mFrame;
+			std::exception_ptr mError;
+			bool mDone = false;
+			bool mStop = false;
+			std::thread mThread;  // last, starts after all other members exist
+	};
+
+	static int64_t percentile(std::vector<int64_t> values, double q)
+	{
+		if (values.empty())
+			return 0;
+		const size_t index = static_cast<size_t>(q * static_cast<double>(values.size() - 1));
+		std::nth_element(values.begin(), values.begin() + index, values.end());
+		return values[index];
+	}
+
+	int live(const std::filesystem::path &sessionDir, const LiveOptions &options, std::atomic<bool>& stopSignal)
+	{
+		auto cameras = openStereoCameras();
+		CameraPtr &leftCamera = cameras.first;
+		CameraPtr &rightCamera = cameras.second;
+
+		std::filesystem::path rawDir = sessionDir / "raw";
+		writeCameraMetadata(rawDir, leftCamera, rightCamera);
+
+		const cv::Size leftResolution = leftCamera->getEventResolution().value();
+		const cv::Size rightResolution = rightCamera->getEventResolution().value();
+
+		// left and right render concurrently, split the cores between them
+		const int threadsPerCamera = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 2);
+		FrameGen::WindowRenderer leftRenderer = FrameGen::makeRenderer(options.backend, leftResolution, options.modelPath, threadsPerCamera);
+		FrameGen::WindowRenderer rightRenderer = FrameGen::makeRenderer(options.backend, rightResolution, options.modelPath, threadsPerCamera);
+		if (!leftRenderer || !rightRenderer)
+			return EXIT_FAILURE;
+		// left renders on its own thread while the main thread renders right
+		RenderWorker leftWorker(std::move(leftRenderer), "live render left");
+
+		std::filesystem::path liveDir = sessionDir / "reconstruction" / "live";
+		std::ofstream leftTimestamps, rightTimestamps;
+		if (options.saveFrames)
+		{
+			std::filesystem::create_directories(liveDir / "left");
+			std::filesystem::create_directories(liveDir / "right");
+			leftTimestamps.open(liveDir / "left" / "timestamps.txt");
+			rightTimestamps.open(liveDir / "right" / "timestamps.txt");
+		}
+
+		StereoRecordingWriter writer(rawDir, *leftCamera, *rightCamera, options.chunks);
+
+		std::mutex queueMutex;
+		std::condition_variable renderQueueCondition;
+		std::deque<std::shared_ptr<const dv::EventStore>> leftQueue;
+		std::deque<std::shared_ptr<const dv::EventStore>> rightQueue;
+		const size_t MAX_QUEUE_SIZE = 32;
+		size_t mergedBatches = 0;
+
+		dv::io::DataReadHandler leftHandler, rightHandler;
+		writer.captureAuxiliary(leftHandler, *leftCamera, true);
+		writer.captureAuxiliary(rightHandler, *rightCamera, false);
+
+		leftHandler.mEventHandler = [&](const dv::EventStore &events) 
+		{
+			// Priority 1: write events
+			writer.writeEvents(true, events);	
+
+			// Priority 2: hand events to the renderer, never drop them here (merge instead)
+			auto leftEventPtr = std::make_shared<dv::EventStore>(events);		
+			{
+				std::scoped_lock<std::mutex> lock(queueMutex);
+				pushBounded(leftQueue, std::move(leftEventPtr), MAX_QUEUE_SIZE, true, mergedBatches);
+			}
+			renderQueueCondition.notify_one();
+		};
+		rightHandler.mEventHandler = [&](const dv::EventStore &events) 
+		{
+			writer.writeEvents(false, events);	
+
+			auto rightEventPtr = std::make_shared<dv::EventStore>(events);		
+			{
+				std::scoped_lock<std::mutex> lock(queueMutex);
+				pushBounded(rightQueue, std::move(rightEventPtr), MAX_QUEUE_SIZE, true, mergedBatches);
+			}
+			renderQueueCondition.notify_one();
+		};
+
+		// recording (producer) thread
+		std::thread recordingThread([&]() {
+			Trace::nameThread("recording");
+			Trace::Span span("recording");
+			Log::info("Starting the recording!");
+			while (!stopSignal.load() && leftCamera->isRunning() && rightCamera->isRunning())
+			{
+				if (!leftCamera->handleNext(leftHandler)) break;
+				if (!rightCamera->handleNext(rightHandler)) break;
+				writer.rollOverIfNeeded();
+			}
+			renderQueueCondition.notify_all();
+			Log::info("Recording Thread Finished");
+		});
+
+		cv::namedWindow("Left", cv::WINDOW_NORMAL);
+		cv::namedWindow("Right", cv::WINDOW_NORMAL);
+
+		const int64_t windowUs = static_cast<int64_t>(options.windowMs) * 1000;
+		const int64_t budgetUs = static_cast<int64_t>(options.latencyBudgetMs) * 1000;
+
+		dv::EventStore pendingLeft, pendingRight;
+		int64_t leftSeen = -1, rightSeen = -1;
+		int64_t windowStart = -1;
+
+		// latency = host time when the frame is shown minus the (master synchronized) end of its window
+		std::vector<int64_t> latencies;
+		std::vector<int64_t> reportLatencies;
+		size_t renderedWindows = 0, mergedWindows = 0, droppedWindows = 0;
+		int64_t lastReport = dv::now();
+
+		Log::info("Live rendering with '", options.backend, "', ", options.windowMs, "ms windows, latency budget ", options.latencyBudgetMs, "ms");
+
+		// render loop (main thread, highgui needs it)
+		bool renderFailed = false;
+		std::optional<Trace::Span> renderSpan(std::in_place, "live render");
+		while (!stopSignal.load())
+		{
+			std::vector<std::shared_ptr<const dv::EventStore>> leftBatches, rightBatches;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+
+				renderQueueCondition.wait_for(lock, std::chrono::milliseconds(10), [&]{
+					return stopSignal.load() || !leftQueue.empty() || !rightQueue.empty();
+				});
+
+				if (stopSignal.load()) break;
+
+				// take everything, falling behind is handled per window below
+				leftBatches.assign(leftQueue.begin(), leftQueue.end());
+				rightBatches.assign(rightQueue.begin(), rightQueue.end());
+				leftQueue.clear();
+				rightQueue.clear();
+			}
+
+			for (const auto &batch : leftBatches)
+			{
+				if (batch->isEmpty()) continue;
+				pendingLeft.add(*batch);
+				leftSeen = std::max(leftSeen, batch->getHighestTime());
+			}
+			for (const auto &batch : rightBatches)
+			{
+				if (batch->isEmpty()) continue;
+				pendingRight.add(*batch);
+				rightSeen = std::max(rightSeen, batch->getHighestTime());
+			}
+
+			if (windowStart < 0)
+			{
+				if (pendingLeft.isEmpty() || pendingRight.isEmpty())
+				{
+					cv::waitKey(1);
+					continue;
+				}
+				windowStart = std::max(pendingLeft.getLowestTime(), pendingRight.getLowestTime());
+			}
+
+			// only windows that are complete on both cameras can be rendered
+			const int64_t completeWindows = (std::min(leftSeen, rightSeen) - windowStart) / windowUs;
+			if (completeWindows <= 0)
+			{
+				cv::waitKey(1);
+				continue;
+			}
+
+			// behind schedule: merge all complete windows into one instead of rendering each
+			const int64_t windowEnd = windowStart + completeWindows * windowUs;
+			mergedWindows += static_cast<size_t>(completeWindows - 1);
+
+			dv::EventStore leftWindow = pendingLeft.sliceTime(windowStart, windowEnd);
+			dv::EventStore rightWindow = pendingRight.sliceTime(windowStart, windowEnd);
+			pendingLeft = pendingLeft.sliceTime(windowEnd);
+			pendingRight = pendingRight.sliceTime(windowEnd);
+			windowStart = windowEnd;
+
+			// still over budget before rendering: drop it, the events are on disk anyway
+			if (dv::now() - windowEnd > budgetUs)
+			{
+				droppedWindows++;
+				cv::waitKey(1);
+				continue;
+			}
+
+			// a failing renderer (e.g. ONNX Runtime) ends the session through the normal teardown below, so the
+			// recording thread is joined and the recording is finalized. The left window is awaited in any case,
+			// the worker still reads it.
+			cv::Mat leftFrame, rightFrame;
+			leftWorker.submit(leftWindow);
+			try
+			{
+				rightFrame = rightRenderer(rightWindow);
+			}
+			catch (const std::exception &e)
+			{
+				Log::error("Rendering the right camera failed: ", e.what());
+				renderFailed = true;
+			}
+			try
+			{
+				leftFrame = leftWorker.wait();
+			}
+			catch (const std::exception &e)
+			{
+				Log::error("Rendering the left camera failed: ", e.what());
+				renderFailed = true;
+			}
+			if (renderFailed)
+			{
+				stopSignal.store(true);
+				break;
+			}
+
+			cv::imshow("Left", leftFrame);
+			cv::imshow("Right", rightFrame);
+
+			const int64_t latency = dv::now() - windowEnd;
+			latencies.push_back(latency);
+			reportLatencies.push_back(latency);
+			renderedWindows++;
+
+			if (options.saveFrames)
+			{
+				char fileName[32];
+				std::snprintf(fileName, sizeof(fileName), "frame_%010zu.png", renderedWindows);
+				cv::imwrite((liveDir / "left" / fileName).string(), leftFrame);
+				cv::imwrite((liveDir / "right" / fileName).string(), rightFrame);
+				leftTimestamps << std::fixed << std::setprecision(6) << (windowEnd / 1e6) << "\n";
+				rightTimestamps << std::fixed << std::setprecision(6) << (windowEnd / 1e6) << "\n";
+			}
+
+			// Signal exit if ESC or "q" key is pressed
+			char key = (char) cv::waitKey(1);
+			if (key == 27 || key == 'q')
+				stopSignal.store(true);
+
+			if (dv::now() - lastReport > 5000000)
+			{
+				Log::info("Live latency p50/p95/max: ", percentile(reportLatencies, 0.5) / 1000, "/", percentile(reportLatencies, 0.95) / 1000, "/", percentile(reportLatencies, 1.0) / 1000, "ms",
+					" | rendered ", renderedWindows, ", merged ", mergedWindows, ", dropped ", droppedWindows);
+				reportLatencies.clear();
+				lastReport = dv::now();
+			}
+		}
+		cv::destroyAllWindows();
+		renderSpan->arg("rendered", renderedWindows);
+		renderSpan->arg("merged", mergedWindows);
+		renderSpan->arg("dropped", droppedWindows);
+		renderSpan->arg("latency_p95_ms", percentile(latencies, 0.95) / 1000.0);
+		renderSpan.reset();
+
+		// Ensure worker thread stops
+		stopSignal.store(true);
+		renderQueueCondition.notify_all();
+		
+		if (recordingThread.joinable())
+			recordingThread.join();
+
+		Log::info("Live session finished: rendered ", renderedWindows, " windows, merged ", mergedWindows, ", dropped ", droppedWindows, " (over ", options.latencyBudgetMs, "ms budget)");
+		Log::info("End-to-end latency p50/p95/max: ", percentile(latencies, 0.5) / 1000, "/", percentile(latencies, 0.95) / 1000, "/", percentile(latencies, 1.0) / 1000, "ms");
+		if (mergedBatches > 0)
+			Log::warn("Renderer queue overflowed ", mergedBatches, " times, batches were merged");
+		if (renderFailed)
+		{
+			Log::error("Live rendering failed, the recording was stopped and saved to ", rawDir.string());
+			return EXIT_FAILURE;
+		}
+
+		return EXIT_SUCCESS;
+	}
 }
@@ -1,8 +1,30 @@
 #pragma once
 #include <filesystem>
 #include <atomic>
+#include <string>
 
 namespace StereoRecorder 
 {
-	int record(const std::filesystem::path &rawDir, bool showVisualization, std::atomic<bool>& stopSignal);
+	// Rotating recordings: with a limit set, raw/ gets stereo_recording_NNNN.aedat4 chunks that are
+	// closed on packet boundaries and listed (with their time range) in raw/chunks.txt once complete
+	struct ChunkOptions
+	{
+		int maxSeconds = 0;    // 0 = no time limit
+		int maxMegabytes = 0;  // 0 = no size limit
+		bool enabled() const { return maxSeconds > 0 || maxMegabytes > 0; }
+	};
+
+	int record(const std::filesystem::path &rawDir, bool showVisualization, std::atomic<bool>& stopSignal, const ChunkOptions &chunks = {});
+
+	struct LiveOptions
+	{
+		std::string backend = "accumulator"; // renderer, see FrameGen::makeRenderer
+		std::filesystem::path modelPath;     // only used by the 'onnx' backend
+		int windowMs = 50;
+		int latencyBudgetMs = 250;           // windows older than this are dropped instead of rendered
+		bool saveFrames = false;             // write frames to <session>/reconstruction/live/
+		ChunkOptions chunks;
+	};
+	// records like record() and renders frames from the same event stream while recording
+	int live(const std::filesystem::path &sessionDir, const LiveOptions &options, std::atomic<bool>& stopSignal);
 }
@@ -0,0 +1,289 @@
+#include "Rectifier.h"
+#include "Log.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#include <opencv2/calib3d.hpp>
+
+namespace Rectify
+{
+	static std::string trim(const std::string& str)
+	{
+		const size_t begin = str.find_first_not_of(" \t\r");
+		if (begin == std::string::npos)
+			return "";
+		const size_t end = str.find_last_not_of(" \t\r");
+		return str.substr(begin, end - begin + 1);
+	}
+
+	// "[a, b, c]" -> {a, b, c}
+	static std::vector<double> parseList(const std::string& value)
+	{
+		std::vector<double> list;
+		std::string inner = trim(value);
+		if (inner.size() < 2 || inner.front() != '[' || inner.back() != ']')
+			return list;
+
+		std::stringstream stream(inner.substr(1, inner.size() - 2));
+		std::string item;
+		while (std::getline(stream, item, ','))
+			list.push_back(std::stod(trim(item)));
+		return list;
+	}
+
+	std::filesystem::path findCamchain(const std::filesystem::path& calibrationDir)
+	{
+		for (const char* name : {"camchain-stereo_frames.yaml", "stereo_frames-camchain.yaml"})
+		{
+			if (std::filesystem::exists(calibrationDir / name))
+				return calibrationDir / name;
+		}
+		return {};
+	}
+
+	// Kalibr writes a small, fixed subset of YAML, so a line based parser is enough here
+	std::optional<StereoCalibration> readCamchain(const std::filesystem::path& file)
+	{
+		std::ifstream stream(file);
+		if (!stream.is_open())
+		{
+			Log::error("Could not open camchain at: ", file.string());
+			return std::nullopt;
+		}
+
+		StereoCalibration calibration;
+		calibration.T_cn_cnm1 = cv::Mat::eye(4, 4, CV_64F);
+		CameraCalibration* camera = nullptr;
+		bool haveTransform = false;
+		int transformRow = -1;
+
+		try
+		{
+			std::string line;
+			while (std::getline(stream, line))
+			{
+				const std::string content = trim(line);
+				if (content.empty() || content.front() == '#')
+					continue;
+
+				// top level "camN:"
+				if (line.front() != ' ' && content.back() == ':')
+				{
+					const std::string name = content.substr(0, content.size() - 1);
+					camera = name == "cam0" ? &calibration.cam0 : name == "cam1" ? &calibration.cam1 : nullptr;
+					transformRow = -1;
+					continue;
+				}
+				if (camera == nullptr)
+					continue;
+
+				// rows of T_cn_cnm1: "- [a, b, c, d]"
+				if (content.front() == '-' && transformRow >= 0 && transformRow < 4)
+				{
+					const std::vector<double> row = parseList(content.substr(1));
+					if (row.size() != 4)
+						throw std::runtime_error("T_cn_cnm1 rows need 4 entries");
+					for (int col = 0; col < 4; col++)
+						calibration.T_cn_cnm1.at<double>(transformRow, col) = row[col];
+					if (++transformRow == 4)
+						haveTransform = camera == &calibration.cam1;
+					continue;
+				}
+
+				const size_t colon = content.find(':');
+				if (colon == std::string::npos)
+					continue;
+				const std::string key = trim(content.substr(0, colon));
+				const std::string value = trim(content.substr(colon + 1));
+
+				if (key == "T_cn_cnm1")
+					transformRow = 0;
+				else if (key == "camera_model")
+					camera->cameraModel = value;
+				else if (key == "distortion_model")
+					camera->distortionModel = value;
+				else if (key == "distortion_coeffs")
+					camera->distortion = parseList(value);
+				else if (key == "intrinsics")
+				{
+					const std::vector<double> intrinsics = parseList(value);
+					if (intrinsics.size() != 4)
+						throw std::runtime_error("intrinsics need 4 entries (fu, fv, pu, pv)");
+					camera->fu = intrinsics[0];
+					camera->fv = intrinsics[1];
+					camera->pu = intrinsics[2];
+					camera->pv = intrinsics[3];
+				}
+				else if (key == "resolution")
+				{
+					const std::vector<double> resolution = parseList(value);
+					if (resolution.size() != 2)
+						throw std::runtime_error("resolution needs 2 entries");
+					camera->resolution = cv::Size(static_cast<int>(resolution[0]), static_cast<int>(resolution[1]));
+				}
+			}
+		}
+		catch (const std::exception& e)
+		{
+			Log::error("Could not parse camchain ", file.string(), ": ", e.what());
+			return std::nullopt;
+		}
+
+		if (calibration.cam0.fu == 0 || calibration.cam1.fu == 0 || !haveTransform)
+		{
+			Log::error("Camchain ", file.string(), " does not contain a calibrated stereo pair (cam0, cam1 with T_cn_cnm1)");
+			return std::nullopt;
+		}
+		return calibration;
+	}
+
+	RectificationMap::RectificationMap(const cv::Size& resolution, std::vector<uint32_t> table) : mResolution(resolution), mTable(std::move(table))
+	{
+		mTable.push_back(INVALID);
+	}
+
+	dv::EventStore RectificationMap::apply(const dv::EventStore& events) const
+	{
+		// gather first (no branches, vectorizes), then compact into the output store.
+		// Coordinates outside the calibrated resolution (callers check it up front) select the INVALID
+		// sentinel after the last pixel instead of reading out of bounds; negative ones wrap to large unsigned values.
+		const uint32_t width = static_cast<uint32_t>(mResolution.width);
+		const uint32_t height = static_cast<uint32_t>(mResolution.height);
+		const uint32_t sentinel = width * height;
+		std::vector<uint32_t> mapped(events.size());
+		size_t i = 0;
+		for (const dv::Event& ev : events)
+		{
+			const uint32_t x = static_cast<uint16_t>(ev.x());
+			const uint32_t y = static_cast<uint16_t>(ev.y());
+			const uint32_t index = (x < width) & (y < height) ? y * width + x : sentinel;
+			mapped[i++] = mTable[index];
+		}
+
+		dv::EventStore rectified;
+		i = 0;
+		for (const dv::Event& ev : events)
+		{
+			const uint32_t target = mapped[i++];
+			if (target != INVALID)
+				rectified.emplace_back(ev.timestamp(), static_cast<int16_t>(target & 0xFFFF), static_cast<int16_t>(target >> 16), ev.polarity());
+		}
+		return rectified;
+	}
+
+	bool RectificationMap::checkResolution(const std::optional<cv::Size>& eventResolution, const std::string& camName) const
+	{
+		if (eventResolution.has_value() && *eventResolution == mResolution)
+			return true;
+		Log::error("Camera ", camName, " does not have the calibrated resolution ", mResolution.width, "x", mResolution.height, ", the calibration does not belong to this recording");
+		return false;
+	}
+
+	static cv::Mat cameraMatrix(const CameraCalibration& camera)
+	{
+		cv::Mat K = cv::Mat::eye(3, 3, CV_64F);
+		K.at<double>(0, 0) = camera.fu;
+		K.at<double>(1, 1) = camera.fv;
+		K.at<double>(0, 2) = camera.pu;
+		K.at<double>(1, 2) = camera.pv;
+		return K;
+	}
+
+	// maps every raw pixel center through undistortion + rectification (R, P) once
+	static RectificationMap buildMap(const CameraCalibration& camera, const cv::Mat& K, const cv::Mat& D, const cv::Mat& R, const cv::Mat& P)
+	{
+		const cv::Size& resolution = camera.resolution;
+		std::vector<cv::Point2f> pixels;
+		pixels.reserve(static_cast<size_t>(resolution.area()));
+		for (int y = 0; y < resolution.height; y++)
+		{
+			for (int x = 0; x < resolution.width; x++)
+				pixels.emplace_back(static_cast<float>(x), static_cast<float>(y));
+		}
+
+		std::vector<cv::Point2f> rectified;
+		if (camera.distortionModel == "equidistant")
+			cv::fisheye::undistortPoints(pixels, rectified, K, D, R, P);
+		else
+			cv::undistortPoints(pixels, rectified, K, D, R, P);
+
+		std::vector<uint32_t> table(pixels.size(), RectificationMap::INVALID);
+		for (size_t i = 0; i < rectified.size(); i++)
+		{
+			const int x = static_cast<int>(std::lround(rectified[i].x));
+			const int y = static_cast<int>(std::lround(rectified[i].y));
+			if (x >= 0 && x < resolution.width && y >= 0 && y < resolution.height)
+				table[i] = (static_cast<uint32_t>(y) << 16) | static_cast<uint32_t>(x);
+		}
+		return RectificationMap(resolution, std::move(table));
+	}
+
+	std::optional<StereoRectification> computeStereoRectification(const StereoCalibration& calibration)
+	{
+		const CameraCalibration& cam0 = calibration.cam0;
+		const CameraCalibration& cam1 = calibration.cam1;
+
+		if (cam0.cameraModel != "pinhole" || cam1.cameraModel != "pinhole")
+		{
+			Log::error("Only pinhole cameras can be rectified (got '", cam0.cameraModel, "', '", cam1.cameraModel, "')");
+			return std::nullopt;
+		}
+		if (cam0.distortionModel != cam1.distortionModel || (cam0.distortionModel != "radtan" && cam0.distortionModel != "equidistant"))
+		{
+			Log::error("Both cameras need the same 'radtan' or 'equidistant' distortion model (got '", cam0.distortionModel, "', '", cam1.distortionModel, "')");
+			return std::nullopt;
+		}
+		if (cam0.resolution.width != cam1.resolution.width || cam0.resolution.height != cam1.resolution.height)
+		{
+			Log::error("Left and right camera resolutions differ, cannot rectify");
+			return std::nullopt;
+		}
+
+		const cv::Mat K0 = cameraMatrix(cam0), K1 = cameraMatrix(cam1);
+		const cv::Mat D0 = cv::Mat(cam0.distortion, true), D1 = cv::Mat(cam1.distortion, true);
+
+		cv::Mat R = cv::Mat::eye(3, 3, CV_64F), T = cv::Mat::zeros(3, 1, CV_64F);
+		for (int row = 0; row < 3; row++)
+		{
+			for (int col = 0; col < 3; col++)
+				R.at<double>(row, col) = calibration.T_cn_cnm1.at<double>(row, col);
+			T.at<double>(row, 0) = calibration.T_cn_cnm1.at<double>(row, 3);
+		}
+
+		StereoRectification rectification;
+		rectification.resolution = cam0.resolution;
+		cv::Mat R1, R2;
+		if (cam0.distortionModel == "equidistant")
+			cv::fisheye::stereoRectify(K0, D0, K1, D1, cam0.resolution, R, T, R1, R2, rectification.P1, rectification.P2, rectification.Q, cv::CALIB_ZERO_DISPARITY);
+		else
+			// alpha = 0: the rectified image only contains valid pixels, events mapped outside are dropped
+			cv::stereoRectify(K0, D0, K1, D1, cam0.resolution, R, T, R1, R2, rectification.P1, rectification.P2, rectification.Q, cv::CALIB_ZERO_DISPARITY, 0);
+
+		rectification.left = buildMap(cam0, K0, D0, R1, rectification.P1);
+		rectification.right = buildMap(cam1, K1, D1, R2, rectification.P2);
+		rectification.focal = rectification.P1.at<double>(0, 0);
+		rectification.baseline = std::sqrt(T.dot(T));
+		return rectification;
+	}
+
+	std::optional<StereoRectification> loadStereoRectification(const std::filesystem::path& calibrationDir)
+	{
+		std::filesystem::path camchain = findCamchain(calibrationDir);
+		if (camchain.empty())
+		{
+			Log::error("No Kalibr camchain found in ", calibrationDir.string(), ". Run sert calibrate first.");
+			return std::nullopt;
+		}
+
+		auto calibration = readCamchain(camchain);
+		if (!calibration.has_value())
+			return std::nullopt;
+
+		auto rectification = computeStereoRectification(*calibration);
+		if (rectification.has_value())
+			Log::info("Loaded stereo rectification from ", camchain.string(), " (f = ", rectification->focal, "px, baseline = ", rectification->baseline, "m)");
+		return rectification;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <dv-processing/core/core.hpp>
+#include <opencv2/core.hpp>
+
+namespace Rectify
+{
+	// One camera of a Kalibr camchain (pinhole with radtan or equidistant distortion)
+	struct CameraCalibration
+	{
+		std::string cameraModel, distortionModel;
+		cv::Size resolution;
+		double fu = 0, fv = 0, pu = 0, pv = 0;
+		std::vector<double> distortion;
+	};
+
+	struct StereoCalibration
+	{
+		CameraCalibration cam0, cam1;  // cam0 = left, cam1 = right (see stereo_frames_to_rosbag.py)
+		cv::Mat T_cn_cnm1;             // 4x4, transforms points from cam0 into cam1
+	};
+
+	// calibration/camchain-stereo_frames.yaml (or Kalibr's default <bag>-camchain.yaml name)
+	std::filesystem::path findCamchain(const std::filesystem::path& calibrationDir);
+	std::optional<StereoCalibration> readCamchain(const std::filesystem::path& file);
+
+	// Per-pixel lookup table from raw sensor coordinates to rectified (undistorted) coordinates.
+	// Each entry is (y << 16 | x) of the rectified pixel, or INVALID if it falls outside the image.
+	// One extra INVALID entry after the last pixel is where coordinates outside the resolution are looked up.
+	class RectificationMap
+	{
+		public:
+			static constexpr uint32_t INVALID = 0xFFFFFFFF;
+
+			RectificationMap() = default;
+			RectificationMap(const cv::Size& resolution, std::vector<uint32_t> table);
+
+			// rectified copy of the events, events that leave the image (or lie outside the calibrated resolution) are dropped
+			dv::EventStore apply(const dv::EventStore& events) const;
+
+			// logs an error if a camera's event resolution differs from the calibrated one
+			bool checkResolution(const std::optional<cv::Size>& eventResolution, const std::string& camName) const;
+
+			const cv::Size& getResolution() const { return mResolution; }
+			bool isValid() const { return !mTable.empty(); }
+
+		private:
+			cv::Size mResolution;
+			std::vector<uint32_t> mTable;
+	};
+
+	struct StereoRectification
+	{
+		RectificationMap left, right;
+		cv::Size resolution;
+		cv::Mat P1, P2, Q;  // rectified projections and disparity-to-depth matrix from cv::stereoRectify
+		double focal = 0.0;     // rectified focal length in pixels
+		double baseline = 0.0;  // in meters
+	};
+
+	std::optional<StereoRectification> computeStereoRectification(const StereoCalibration& calibration);
+	// findCamchain + readCamchain + computeStereoRectification, logs what went wrong
+	std::optional<StereoRectification> loadStereoRectification(const std::filesystem::path& calibrationDir);
+}
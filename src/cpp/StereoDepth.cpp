@@ -0,0 +1,443 @@
+#include "StereoDepth.h"
+#include "FrameGenerator.h"
+#include "Log.h"
+#include "Rectifier.h"
+#include "Tracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <dv-processing/core/core.hpp>
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace Depth
+{
+	// rows per matching task. The per-disparity working set ((16 + 2r) rows of absolute differences plus
+	// their box sums, ~100 KB at 640px width) stays in L2; the full tile cost volume (65 x 16 x 640 floats,
+	// ~2.6 MB at 64 disparities) does not, it is written once per disparity and read once per pixel.
+	static constexpr int TILE_ROWS = 16;
+
+	// Persistent threads for a whole run. run() hands out tasks dynamically, the calling thread
+	// works along (as worker 0), and returns once every task is done. No threads are created per window.
+	class WorkerPool
+	{
+		public:
+			explicit WorkerPool(int workers)
+			{
+				for (int w = 1; w < workers; w++)
+					mThreads.emplace_back([this, w]() { loop(w); });
+			}
+
+			~WorkerPool()
+			{
+				{
+					std::scoped_lock<std::mutex> lock(mMutex);
+					mStop = true;
+				}
+				mStart.notify_all();
+				for (auto& thread : mThreads)
+					thread.join();
+			}
+
+			int size() const { return static_cast<int>(mThreads.size()) + 1; }
+
+			// runs fn(task, worker) for task in [0, numTasks), worker in [0, size()) identifies the executing thread
+			void run(int numTasks, const std::function<void(int, int)>& fn)
+			{
+				{
+					std::scoped_lock<std::mutex> lock(mMutex);
+					mFn = &fn;
+					mNumTasks = numTasks;
+					mNext = 0;
+					mBusy = mThreads.size();
+					mGeneration++;
+				}
+				mStart.notify_all();
+				work(0);
+
+				std::unique_lock<std::mutex> lock(mMutex);
+				mDone.wait(lock, [&]{ return mBusy == 0; });
+				mFn = nullptr;
+			}
+
+		private:
+			void work(int worker)
+			{
+				for (int task = mNext++; task < mNumTasks; task = mNext++)
+					(*mFn)(task, worker);
+			}
+
+			void loop(int worker)
+			{
+				Trace::nameThread("depth worker");
+				uint64_t seenGeneration = 0;
+				std::unique_lock<std::mutex> lock(mMutex);
+				while (true)
+				{
+					mStart.wait(lock, [&]{ return mStop || mGeneration != seenGeneration; });
+					if (mStop)
+						return;
+					seenGeneration = mGeneration;
+					lock.unlock();
+					work(worker);
+					lock.lock();
+					if (--mBusy == 0)
+						mDone.notify_one();
+				}
+			}
+
+			std::vector<std::thread> mThreads;
+			std::mutex mMutex;
+			std::condition_variable mStart, mDone;
+			const std::function<void(int, int)>* mFn = nullptr;
+			std::atomic<int> mNext{0};
+			int mNumTasks = 0;
+			size_t mBusy = 0;
+			uint64_t mGeneration = 0;
+			bool mStop = false;
+	};
+
+	// last event timestamp per pixel, rendered into exp(-(t - t_last) / tau) at the end of each window
+	struct TimeSurface
+	{
+		cv::Size resolution;
+		std::vector<int64_t> lastTimestamp;
+		std::vector<float> surface;
+
+		explicit TimeSurface(const cv::Size& res) :
+			resolution(res),
+			lastTimestamp(static_cast<size_t>(res.area()), std::numeric_limits<int64_t>::min()),
+			surface(static_cast<size_t>(res.area()), 0.0f)
+		{
+		}
+
+		void accept(const dv::EventStore& events)
+		{
+			for (const dv::Event& ev : events)
+				lastTimestamp[static_cast<size_t>(ev.y()) * resolution.width + ev.x()] = ev.timestamp();
+		}
+
+		void render(int64_t time, float decayUs, int rowBegin, int rowEnd)
+		{
+			const size_t begin = static_cast<size_t>(rowBegin) * resolution.width;
+			const size_t end = static_cast<size_t>(rowEnd) * resolution.width;
+			for (size_t i = begin; i < end; i++)
+			{
+				const int64_t last = lastTimestamp[i];
+				surface[i] = last == std::numeric_limits<int64_t>::min() ? 0.0f : std::exp(-static_cast<float>(time - last) / decayUs);
+			}
+		}
+	};
+
+	// buffers of one worker, sized on first use and reused for every tile of every window
+	struct MatchScratch
+	{
+		cv::Mat absDiff, boxSum;  // (TILE_ROWS + 2r) x width
+		std::vector<float> costs; // (maxDisparity + 1) planes of TILE_ROWS x width
+	};
+
+	// Block matching of rows [rowBegin, rowEnd) of the left time surface against the right one.
+	// Costs are aggregated per disparity plane for the whole band of rows with OpenCV's SIMD kernels
+	// (absdiff, then an unnormalized box filter = sum of absolute differences over the block).
+	// Only pixels with an event in the current window get a disparity, everything else stays 0.
+	static void matchRows(const TimeSurface& left, const TimeSurface& right, int64_t windowStart, int rowBegin, int rowEnd, const Options& options, MatchScratch& scratch, float* disparity)
+	{
+		const int width = left.resolution.width;
+		const int height = left.resolution.height;
+		const int r = options.blockRadius;
+		const int block = 2 * r + 1;
+		const int maxD = options.maxDisparity;
+		const int numD = maxD + 1;
+
+		rowBegin = std::max(rowBegin, r);
+		rowEnd = std::min(rowEnd, height - r);
+		if (rowBegin >= rowEnd)
+			return;
+
+		// nothing to do for tiles without events
+		bool active = false;
+		for (size_t i = static_cast<size_t>(rowBegin) * width; i < static_cast<size_t>(rowEnd) * width && !active; i++)
+			active = left.lastTimestamp[i] >= windowStart;
+		if (!active)
+			return;
+
+		const int rows = rowEnd - rowBegin;
+		const int bandBegin = rowBegin - r;
+		const int bandRows = rows + 2 * r;
+
+		// headers on the surfaces, nothing is copied (Mat only takes non-const data, it is only read)
+		const cv::Mat leftBand(bandRows, width, CV_32FC1, const_cast<float*>(&left.surface[static_cast<size_t>(bandBegin) * width]));
+		const cv::Mat rightBand(bandRows, width, CV_32FC1, const_cast<float*>(&right.surface[static_cast<size_t>(bandBegin) * width]));
+		scratch.absDiff.create(TILE_ROWS + 2 * r, width, CV_32FC1);
+		scratch.boxSum.create(TILE_ROWS + 2 * r, width, CV_32FC1);
+		scratch.costs.resize(static_cast<size_t>(numD) * TILE_ROWS * width);
+		float* costs = scratch.costs.data();
+
+		for (int d = 0; d <= maxD; d++)
+		{
+			// both blocks must lie inside the image: x - d - r >= 0 and x + r < width
+			const int shiftedWidth = width - d;
+			const int validBegin = r + d;
+			const int validEnd = width - r;
+			if (shiftedWidth >= block)
+			{
+				// column j of the shifted plane compares left pixel j + d with right pixel j
+				const cv::Rect shifted(0, 0, shiftedWidth, bandRows);
+				cv::Mat absDiff = scratch.absDiff(shifted);
+				cv::Mat boxSum = scratch.boxSum(shifted);
+				cv::absdiff(leftBand(cv::Rect(d, 0, shiftedWidth, bandRows)), rightBand(shifted), absDiff);
+				cv::boxFilter(absDiff, boxSum, -1, cv::Size(block, block), cv::Point(-1, -1), false, cv::BORDER_REPLICATE | cv::BORDER_ISOLATED);
+			}
+
+			for (int y = 0; y < rows; y++)
+			{
+				float* cost = &costs[(static_cast<size_t>(d) * rows + y) * width];
+				if (validBegin >= validEnd)
+				{
+					std::fill(cost, cost + width, std::numeric_limits<float>::max());
+					continue;
+				}
+				// box sums of the border columns are discarded, they would include replicated pixels
+				const float* sum = scratch.boxSum.ptr<float>(y + r);
+				std::fill(cost, cost + validBegin, std::numeric_limits<float>::max());
+				std::copy(sum + r, sum + shiftedWidth - r, cost + validBegin);
+				std::fill(cost + validEnd, cost + width, std::numeric_limits<float>::max());
+			}
+		}
+
+		const float blockArea = static_cast<float>((2 * r + 1) * (2 * r + 1));
+		const size_t plane = static_cast<size_t>(rows) * width;
+		for (int y = 0; y < rows; y++)
+		{
+			const size_t rowOffset = static_cast<size_t>(rowBegin + y) * width;
+			for (int x = r; x < width - r; x++)
+			{
+				if (left.lastTimestamp[rowOffset + x] < windowStart)
+					continue;
+
+				const size_t pixel = static_cast<size_t>(y) * width + x;
+				int best = -1;
+				float bestCost = std::numeric_limits<float>::max();
+				for (int d = 0; d <= maxD; d++)
+				{
+					const float cost = costs[d * plane + pixel];
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						best = d;
+					}
+				}
+				// disparity 0 is at infinity, no depth from it
+				if (best < 1 || bestCost / blockArea > options.maxCost)
+					continue;
+
+				float secondCost = std::numeric_limits<float>::max();
+				for (int d = 0; d <= maxD; d++)
+				{
+					if (std::abs(d - best) > 1)
+						secondCost = std::min(secondCost, costs[d * plane + pixel]);
+				}
+				if (bestCost > options.uniqueness * secondCost)
+					continue;
+
+				// sub-pixel refinement with a parabola through the neighbouring costs
+				float refined = static_cast<float>(best);
+				if (best < maxD)
+				{
+					const float c0 = costs[(best - 1) * plane + pixel], c1 = bestCost, c2 = costs[(best + 1) * plane + pixel];
+					const float denominator = c0 - 2.0f * c1 + c2;
+					if (c0 < std::numeric_limits<float>::max() && c2 < std::numeric_limits<float>::max() && denominator > 0.0f)
+						refined += 0.5f * (c0 - c2) / denominator;
+				}
+				disparity[rowOffset + x] = refined;
+			}
+		}
+	}
+
+	static void writePointCloud(const std::filesystem::path& file, const std::vector<cv::Point3f>& points)
+	{
+		std::ofstream pcd(file);
+		pcd << "# .PCD v0.7 - Point Cloud Data file format\n";
+		pcd << "VERSION 0.7\nFIELDS x y z\nSIZE 4 4 4\nTYPE F F F\nCOUNT 1 1 1\n";
+		pcd << "WIDTH " << points.size() << "\nHEIGHT 1\nVIEWPOINT 0 0 0 1 0 0 0\n";
+		pcd << "POINTS " << points.size() << "\nDATA ascii\n";
+		for (const cv::Point3f& point : points)
+			pcd << point.x << " " << point.y << " " << point.z << "\n";
+	}
+
+	int run(const std::filesystem::path& sessionDir, const Options& options)
+	{
+		std::filesystem::path rawDir = sessionDir / "raw";
+		std::filesystem::path esvoDir = sessionDir / "esvo";
+		std::filesystem::path depthDir = esvoDir / "depth";
+		std::filesystem::path cloudDir = esvoDir / "pointclouds";
+		std::vector<std::filesystem::path> recordingFiles = FrameGen::recordingFiles(rawDir);
+
+		if (recordingFiles.empty())
+		{
+			Log::error("Could not find a recording in: ", rawDir.string());
+			return EXIT_FAILURE;
+		}
+
+		auto rectification = Rectify::loadStereoRectification(sessionDir / "calibration");
+		if (!rectification.has_value())
+		{
+			Log::error("Depth estimation needs rectified events. Aborting...");
+			return EXIT_FAILURE;
+		}
+
+		FrameGen::CameraMetadata meta = FrameGen::readMetadata(rawDir);
+		FrameGen::ChunkedEventReader leftReader(recordingFiles, meta.leftCamName);
+		FrameGen::ChunkedEventReader rightReader(recordingFiles, meta.rightCamName);
+
+		const cv::Size resolution = rectification->resolution;
+		if (leftReader.getEventResolution() != resolution || rightReader.getEventResolution() != resolution)
+		{
+			Log::error("Recording resolution does not match the calibration resolution ", resolution.width, "x", resolution.height);
+			return EXIT_FAILURE;
+		}
+
+		std::filesystem::create_directories(depthDir);
+		if (options.writePointClouds)
+			std::filesystem::create_directories(cloudDir);
+		std::ofstream timestampsFile(depthDir / "timestamps.txt");
+
+		const int workers = options.workers > 0 ? options.workers : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+		const int64_t windowUs = static_cast<int64_t>(options.windowMs) * 1000;
+		const float decayUs = static_cast<float>(options.decayMs) * 1000.0f;
+		const int numTiles = (resolution.height + TILE_ROWS - 1) / TILE_ROWS;
+		WorkerPool pool(std::min(workers, numTiles));
+		std::vector<MatchScratch> scratch(static_cast<size_t>(pool.size()));
+
+		// depth = f * B / d, points in the rectified left camera frame
+		const double focalBaseline = rectification->focal * rectification->baseline;
+		const double cx = rectification->P1.at<double>(0, 2);
+		const double cy = rectification->P1.at<double>(1, 2);
+
+		TimeSurface leftSurface(resolution), rightSurface(resolution);
+		std::vector<float> disparity(static_cast<size_t>(resolution.area()));
+
+		dv::EventStore pendingLeft, pendingRight;
+		int64_t leftSeen = -1, rightSeen = -1;
+		int64_t windowStart = -1;
+		int64_t firstTimestamp = -1, lastTimestamp = -1;
+		bool leftDone = false, rightDone = false;
+		size_t windowCount = 0;
+		size_t depthPixels = 0;
+
+		Log::info("Native stereo depth: ", options.windowMs, "ms windows, ", options.maxDisparity, " disparities, ", 2 * options.blockRadius + 1, "x", 2 * options.blockRadius + 1, " blocks, ", workers, " threads");
+		const auto startTime = std::chrono::steady_clock::now();
+		Trace::Span span("stereo depth");
+
+		auto processWindow = [&](int64_t windowEnd) {
+			leftSurface.accept(pendingLeft.sliceTime(windowStart, windowEnd));
+			rightSurface.accept(pendingRight.sliceTime(windowStart, windowEnd));
+			pendingLeft = pendingLeft.sliceTime(windowEnd);
+			pendingRight = pendingRight.sliceTime(windowEnd);
+
+			pool.run(numTiles, [&](int tile, int) {
+				const int rowBegin = tile * TILE_ROWS;
+				const int rowEnd = std::min(rowBegin + TILE_ROWS, resolution.height);
+				leftSurface.render(windowEnd, decayUs, rowBegin, rowEnd);
+				rightSurface.render(windowEnd, decayUs, rowBegin, rowEnd);
+			});
+
+			std::fill(disparity.begin(), disparity.end(), 0.0f);
+			pool.run(numTiles, [&](int tile, int worker) {
+				const int rowBegin = tile * TILE_ROWS;
+				matchRows(leftSurface, rightSurface, windowStart, rowBegin, std::min(rowBegin + TILE_ROWS, resolution.height), options, scratch[worker], disparity.data());
+			});
+
+			cv::Mat depthMap = cv::Mat::zeros(resolution.height, resolution.width, CV_16UC1);
+			std::vector<cv::Point3f> points;
+			for (int y = 0; y < resolution.height; y++)
+			{
+				uint16_t* depthRow = depthMap.ptr<uint16_t>(y);
+				for (int x = 0; x < resolution.width; x++)
+				{
+					const float d = disparity[static_cast<size_t>(y) * resolution.width + x];
+					if (d <= 0.0f)
+						continue;
+					const double z = focalBaseline / d;
+					depthRow[x] = static_cast<uint16_t>(std::min(z * 1000.0, 65535.0));
+					if (options.writePointClouds)
+						points.push_back({static_cast<float>((x - cx) * z / rectification->focal), static_cast<float>((y - cy) * z / rectification->focal), static_cast<float>(z)});
+					depthPixels++;
+				}
+			}
+
+			char fileName[32];
+			std::snprintf(fileName, sizeof(fileName), "depth_%010zu.png", windowCount);
+			cv::imwrite((depthDir / fileName).string(), depthMap);
+			timestampsFile << std::fixed << std::setprecision(6) << (windowEnd / 1e6) << "\n";
+			if (options.writePointClouds)
+			{
+				std::snprintf(fileName, sizeof(fileName), "cloud_%010zu.pcd", windowCount);
+				writePointCloud(cloudDir / fileName, points);
+			}
+
+			windowCount++;
+			windowStart = windowEnd;
+		};
+
+		while (!leftDone || !rightDone)
+		{
+			// read from whichever camera is behind so both pending stores cover the same time span
+			const bool readLeft = !leftDone && (rightDone || leftSeen <= rightSeen);
+			auto events = readLeft ? leftReader.getNextEventBatch() : rightReader.getNextEventBatch();
+			if (!events.has_value())
+			{
+				(readLeft ? leftDone : rightDone) = true;
+				continue;
+			}
+
+			dv::EventStore rectified = readLeft ? rectification->left.apply(*events) : rectification->right.apply(*events);
+			if (rectified.isEmpty())
+				continue;
+
+			if (firstTimestamp < 0)
+				firstTimestamp = rectified.getLowestTime();
+			lastTimestamp = std::max(lastTimestamp, rectified.getHighestTime());
+			if (readLeft)
+			{
+				pendingLeft.add(rectified);
+				leftSeen = rectified.getHighestTime();
+			}
+			else
+			{
+				pendingRight.add(rectified);
+				rightSeen = rectified.getHighestTime();
+			}
+
+			if (leftSeen < 0 || rightSeen < 0)
+				continue;
+			if (windowStart < 0)
+				windowStart = std::max(pendingLeft.getLowestTime(), pendingRight.getLowestTime());
+
+			while (std::min(leftSeen, rightSeen) >= windowStart + windowUs)
+				processWindow(windowStart + windowUs);
+		}
+
+		const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		const double recorded = (lastTimestamp - firstTimestamp) / 1e6;
+		span.arg("depth_maps", windowCount);
+		span.arg("depth_points", depthPixels);
+		Log::info("Depth estimation finished: ", windowCount, " depth maps, ", depthPixels, " depth points in ", elapsed, "s (", recorded > 0 ? recorded / elapsed : 0.0, "x real time)");
+		Log::info("Results written to ", esvoDir.string());
+		return EXIT_SUCCESS;
+	}
+}
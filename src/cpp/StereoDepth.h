@@ -0,0 +1,21 @@
+#pragma once
+#include <filesystem>
+
+namespace Depth
+{
+	struct Options
+	{
+		int windowMs = 50;         // one depth map per window
+		int decayMs = 30;          // time surface decay constant
+		int maxDisparity = 64;     // search range along the (rectified) epipolar line
+		int blockRadius = 3;       // matching block is (2r+1)x(2r+1)
+		float maxCost = 0.25f;     // mean absolute time surface difference a match may have
+		float uniqueness = 0.9f;   // best cost must be below uniqueness * second best
+		int workers = 0;           // 0 = hardware concurrency
+		bool writePointClouds = false;
+	};
+
+	// Native event-based stereo: rectifies both event streams with the session's Kalibr calibration,
+	// block-matches the time surfaces of both cameras and writes per-window depth maps to <session>/esvo/
+	int run(const std::filesystem::path& sessionDir, const Options& options);
+}
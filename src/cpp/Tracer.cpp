@@ -0,0 +1,260 @@
+#include "Tracer.h"
+#include "Log.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace Trace
+{
+	static bool enabled = true;
+	static std::atomic<bool> sessionActive(false);
+	static std::chrono::steady_clock::time_point origin;
+
+	// finished events as JSON objects, appended at the end of each span (a few per stage)
+	static std::mutex eventsMutex;
+	static std::vector<std::string> events;
+
+	static int64_t nowUs()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+	}
+
+	static int64_t threadCpuUs()
+	{
+		timespec ts{};
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+		return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+	}
+
+	static double toMs(const timeval& tv)
+	{
+		return tv.tv_sec * 1e3 + tv.tv_usec / 1e3;
+	}
+
+	// small stable ids instead of pthread ids, the trace viewers sort tracks by them
+	static int threadId()
+	{
+		static std::atomic<int> nextId(1);
+		thread_local int id = nextId++;
+		return id;
+	}
+
+	std::string escapeJson(const std::string& str)
+	{
+		std::string escaped;
+		escaped.reserve(str.size());
+		for (char c : str)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			if (static_cast<unsigned char>(c) < 0x20)
+				escaped += ' ';
+			else
+				escaped += c;
+		}
+		return escaped;
+	}
+
+	static std::string numberArg(const std::string& key, double value)
+	{
+		std::ostringstream arg;
+		arg << std::setprecision(10) << "\"" << escapeJson(key) << "\": " << value;
+		return arg.str();
+	}
+
+	static std::string stringArg(const std::string& key, const std::string& value)
+	{
+		return "\"" + escapeJson(key) + "\": \"" + escapeJson(value) + "\"";
+	}
+
+	// complete ("X") event of the calling thread
+	static void addSpan(const std::string& name, int64_t startUs, int64_t endUs, const std::vector<std::string>& args)
+	{
+		std::ostringstream event;
+		event << "{\"name\": \"" << escapeJson(name) << "\", \"ph\": \"X\", \"ts\": " << startUs << ", \"dur\": " << endUs - startUs
+			  << ", \"pid\": " << getpid() << ", \"tid\": " << threadId() << ", \"args\": {";
+		for (size_t i = 0; i < args.size(); i++)
+			event << (i > 0 ? ", " : "") << args[i];
+		event << "}}";
+
+		std::lock_guard<std::mutex> lock(eventsMutex);
+		events.push_back(event.str());
+	}
+
+	void setEnabled(bool enable)
+	{
+		enabled = enable;
+	}
+
+	Session::Session(const std::filesystem::path& sessionDir, const std::string& command) : mCommand(command)
+	{
+		// only one session per process, nested ones are ignored
+		if (!enabled || sessionActive.exchange(true))
+			return;
+
+		std::time_t now = std::time(nullptr);
+		std::ostringstream fileName;
+		fileName << command << "_" << std::put_time(std::localtime(&now), "%Y-%m-%d_%H-%M-%S") << ".json";
+		mFile = sessionDir / "traces" / fileName.str();
+
+		origin = std::chrono::steady_clock::now();
+		mStartUs = nowUs();
+		mActive = true;
+		nameThread("main");
+	}
+
+	Session::~Session()
+	{
+		if (!mActive)
+			return;
+
+		rusage self{}, children{};
+		getrusage(RUSAGE_SELF, &self);
+		getrusage(RUSAGE_CHILDREN, &children);
+		addSpan("sert " + mCommand, mStartUs, nowUs(), {
+			numberArg("cpu_user_ms", toMs(self.ru_utime)),
+			numberArg("cpu_sys_ms", toMs(self.ru_stime)),
+			numberArg("peak_rss_mb", self.ru_maxrss / 1024.0),
+			numberArg("children_cpu_user_ms", toMs(children.ru_utime)),
+			numberArg("children_cpu_sys_ms", toMs(children.ru_stime)),
+			numberArg("children_peak_rss_mb", children.ru_maxrss / 1024.0),
+		});
+		sessionActive.store(false);
+
+		// the command failed before the session existed, nothing to attach the trace to
+		const std::filesystem::path sessionDir = mFile.parent_path().parent_path();
+		if (!std::filesystem::is_directory(sessionDir))
+			return;
+
+		std::error_code error;
+		std::filesystem::create_directories(mFile.parent_path(), error);
+		std::ofstream file(mFile);
+		if (!file.is_open())
+		{
+			Log::warn("Could not write trace to: ", mFile.string());
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(eventsMutex);
+		file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+		for (size_t i = 0; i < events.size(); i++)
+			file << events[i] << (i + 1 < events.size() ? ",\n" : "\n");
+		file << "]}\n";
+		events.clear();
+		Log::info("Trace written to ", mFile.string());
+	}
+
+	Span::Span(std::string name) : mName(std::move(name))
+	{
+		if (!sessionActive.load(std::memory_order_relaxed))
+			return;
+		mActive = true;
+		mStartUs = nowUs();
+		mStartCpuUs = threadCpuUs();
+	}
+
+	Span::~Span()
+	{
+		if (!mActive || !sessionActive.load(std::memory_order_relaxed))
+			return;
+		mArgs.push_back(numberArg("cpu_ms", (threadCpuUs() - mStartCpuUs) / 1e3));
+		addSpan(mName, mStartUs, nowUs(), mArgs);
+	}
+
+	void Span::arg(const std::string& key, double value)
+	{
+		if (mActive)
+			mArgs.push_back(numberArg(key, value));
+	}
+
+	void Span::arg(const std::string& key, const std::string& value)
+	{
+		if (mActive)
+			mArgs.push_back(stringArg(key, value));
+	}
+
+	void nameThread(const std::string& name)
+	{
+		if (!sessionActive.load(std::memory_order_relaxed))
+			return;
+		std::ostringstream event;
+		event << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << getpid() << ", \"tid\": " << threadId()
+			  << ", \"args\": {" << stringArg("name", name) << "}}";
+
+		std::lock_guard<std::mutex> lock(eventsMutex);
+		events.push_back(event.str());
+	}
+
+	int runCommand(const std::string& name, const std::string& command, const std::filesystem::path& containerStats)
+	{
+		const int64_t startUs = nowUs();
+
+		// stats of an earlier run must not end up in this span
+		std::error_code error;
+		if (!containerStats.empty())
+			std::filesystem::remove(containerStats, error);
+
+		// fork/exec + wait4 instead of std::system, only this way the child's rusage is available
+		const pid_t pid = fork();
+		if (pid < 0)
+		{
+			Log::error("Could not start '", name, "'");
+			return -1;
+		}
+		if (pid == 0)
+		{
+			execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char*>(nullptr));
+			_exit(127);
+		}
+
+		int status = 0;
+		rusage usage{};
+		while (wait4(pid, &status, 0, &usage) < 0)
+		{
+			if (errno != EINTR)
+			{
+				Log::error("Lost track of '", name, "'");
+				return -1;
+			}
+		}
+
+		if (sessionActive.load(std::memory_order_relaxed))
+		{
+			const std::string prefix = containerStats.empty() ? "" : "client_";
+			std::vector<std::string> args = {
+				stringArg("command", command),
+				numberArg("exit_code", WIFEXITED(status) ? WEXITSTATUS(status) : -1),
+				numberArg(prefix + "cpu_user_ms", toMs(usage.ru_utime)),
+				numberArg(prefix + "cpu_sys_ms", toMs(usage.ru_stime)),
+				numberArg(prefix + "peak_rss_mb", usage.ru_maxrss / 1024.0),
+			};
+
+			if (!containerStats.empty())
+			{
+				std::ifstream stats(containerStats);
+				std::string key;
+				double value = 0;
+				size_t count = 0;
+				while (stats >> key >> value)
+				{
+					args.push_back(numberArg("container_" + key, value));
+					count++;
+				}
+				if (count == 0)
+					args.push_back(stringArg("container_stats", "unavailable (no cgroup counters in " + containerStats.string() + ")"));
+			}
+			addSpan(name, startUs, nowUs(), args);
+		}
+		return status;
+	}
+}
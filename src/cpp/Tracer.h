@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace Trace
+{
+	// tracing is on by default, --no-trace turns it off before a Session is created
+	void setEnabled(bool enabled);
+
+	// Collects the spans of one sert invocation and writes them as Chrome trace JSON
+	// (chrome://tracing or ui.perfetto.dev) to <session>/traces/<command>_<time>.json when it goes out of scope.
+	// The whole invocation is one span with the CPU time and peak RSS of sert and all of its children.
+	class Session
+	{
+		public:
+			Session(const std::filesystem::path& sessionDir, const std::string& command);
+			~Session();
+			Session(const Session&) = delete;
+			Session& operator=(const Session&) = delete;
+
+		private:
+			std::filesystem::path mFile;
+			std::string mCommand;
+			int64_t mStartUs = 0;
+			bool mActive = false;
+	};
+
+	// Records the time from construction to destruction on the calling thread (wall and thread CPU time).
+	// Meant for stages, not for single events or packets; a no-op while no Session is active.
+	class Span
+	{
+		public:
+			explicit Span(std::string name);
+			~Span();
+			Span(const Span&) = delete;
+			Span& operator=(const Span&) = delete;
+
+			void arg(const std::string& key, double value);
+			void arg(const std::string& key, const std::string& value);
+
+		private:
+			std::string mName;
+			int64_t mStartUs = 0, mStartCpuUs = 0;
+			std::vector<std::string> mArgs;
+			bool mActive = false;
+	};
+
+	// names the calling thread in the trace
+	void nameThread(const std::string& name);
+
+	// escapes a string for a JSON string literal (quotes, backslashes, control characters)
+	std::string escapeJson(const std::string& str);
+
+	// Replacement for std::system (same return value) that records the child process as a span
+	// with its user/system CPU time, peak RSS and exit code.
+	// For commands that hand the work to a docker container the rusage only covers the docker CLI; those pass
+	// containerStats, a "<key> <value>" file the container writes from its cgroup counters. Then the rusage
+	// args are prefixed with client_ and the file's values are added with a container_ prefix.
+	int runCommand(const std::string& name, const std::string& command, const std::filesystem::path& containerStats = {});
+}
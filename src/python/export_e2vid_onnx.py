@@ -0,0 +1,88 @@
+import os
+import sys
+import argparse
+import torch
+
+# rpg_e2vid is not a package, make its modules importable
+E2VID_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "rpg_e2vid")
+sys.path.insert(0, E2VID_DIR)
+
+from utils.loading_utils import load_model
+
+
+class E2VIDStateful(torch.nn.Module):
+    # Flattens the recurrent states of E2VID into plain tensors so they can be
+    # passed in and out of the ONNX graph: (voxel, *states) -> (image, *states)
+    def __init__(self, model, state_layout):
+        super().__init__()
+        self.model = model
+        self.state_layout = state_layout
+
+    def forward(self, voxel, *flat_states):
+        states = []
+        idx = 0
+        for size in self.state_layout:
+            states.append(tuple(flat_states[idx:idx + size]) if size > 1 else flat_states[idx])
+            idx += size
+        image, new_states = self.model(voxel, states)
+        return (image, *flatten_states(new_states))
+
+
+def flatten_states(states):
+    flat = []
+    for state in states:
+        if isinstance(state, (tuple, list)):
+            flat.extend(state)
+        else:
+            flat.append(state)
+    return flat
+
+
+def state_layout_of(states):
+    return [len(s) if isinstance(s, (tuple, list)) else 1 for s in states]
+
+
+def padded(size, num_encoders):
+    # same as rpg_e2vid's CropParameters: pad up to a multiple of 2^num_encoders
+    multiple = 2 ** num_encoders
+    return ((size + multiple - 1) // multiple) * multiple
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--path_to_model", default=os.path.join(E2VID_DIR, "pretrained", "E2VID_lightweight.pth.tar"))
+    parser.add_argument("--output", default=os.path.join(E2VID_DIR, "pretrained", "E2VID_lightweight.onnx"))
+    parser.add_argument("--width", type=int, default=640, help="Sensor width of the cameras")
+    parser.add_argument("--height", type=int, default=480, help="Sensor height of the cameras")
+    args = parser.parse_args()
+
+    model = load_model(args.path_to_model).cpu().eval()
+    num_bins = model.num_bins
+    num_encoders = model.num_encoders
+    height = padded(args.height, num_encoders)
+    width = padded(args.width, num_encoders)
+
+    voxel = torch.zeros(1, num_bins, height, width)
+    with torch.no_grad():
+        # a first pass without states tells us their layout and shapes
+        _, states = model(voxel, None)
+    layout = state_layout_of(states)
+    flat_states = [torch.zeros_like(s) for s in flatten_states(states)]
+
+    wrapper = E2VIDStateful(model, layout).eval()
+    input_names = ["voxel"] + [f"state_in_{i}" for i in range(len(flat_states))]
+    output_names = ["image"] + [f"state_out_{i}" for i in range(len(flat_states))]
+
+    torch.onnx.export(
+        wrapper,
+        (voxel, *flat_states),
+        args.output,
+        input_names=input_names,
+        output_names=output_names,
+        opset_version=17,
+    )
+    print(f"Exported {args.path_to_model} ({width}x{height}, {num_bins} bins, {len(flat_states)} state tensors) to {args.output}")
+
+
+if __name__ == "__main__":
+    main()